@@ -0,0 +1,113 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017-2019 Gian-Carlo Pascutto
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#include "config.h"
+#include "AnalysisEngine.h"
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <utility>
+
+AnalysisEngine::AnalysisEngine(Network & network, size_t searches,
+                               size_t threads_per_search)
+    : m_network(network), m_stream_jobs(std::max(searches, size_t{1})) {
+    for (auto i = size_t{0}; i < m_stream_jobs.size(); i++) {
+        m_workers.emplace_back(&AnalysisEngine::worker, this,
+                               i, threads_per_search);
+    }
+}
+
+AnalysisEngine::~AnalysisEngine() {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_exit = true;
+    }
+    m_condvar.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+std::future<AnalysisResult> AnalysisEngine::submit(const GameState & state,
+                                                   int visits) {
+    auto job = Job{state, visits, std::promise<AnalysisResult>{}};
+    auto result = job.result.get_future();
+    enqueue(m_jobs, std::move(job));
+    return result;
+}
+
+std::future<AnalysisResult> AnalysisEngine::submit(const GameState & state,
+                                                   int visits,
+                                                   size_t stream) {
+    auto job = Job{state, visits, std::promise<AnalysisResult>{}};
+    auto result = job.result.get_future();
+    enqueue(m_stream_jobs[stream % m_stream_jobs.size()], std::move(job));
+    return result;
+}
+
+void AnalysisEngine::enqueue(std::deque<Job> & queue, Job && job) {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        queue.emplace_back(std::move(job));
+    }
+    m_condvar.notify_all();
+}
+
+void AnalysisEngine::worker(size_t index, size_t threads) {
+    auto state = std::make_unique<GameState>();
+    auto search = std::make_unique<UCTSearch>(*state, m_network);
+    search->set_thread_count(threads);
+    search->set_concurrent_searches(m_stream_jobs.size());
+
+    auto& stream_jobs = m_stream_jobs[index];
+    for (;;) {
+        auto job = std::unique_ptr<Job>{};
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condvar.wait(lock, [&] {
+                return m_exit || !stream_jobs.empty() || !m_jobs.empty();
+            });
+            // Streams first, their order matters for tree reuse.
+            auto& queue = !stream_jobs.empty() ? stream_jobs : m_jobs;
+            if (queue.empty()) {
+                return;
+            }
+            job = std::make_unique<Job>(std::move(queue.front()));
+            queue.pop_front();
+        }
+
+        try {
+            *state = job->state;
+            job->result.set_value(search->analyze(job->visits));
+        } catch (...) {
+            job->result.set_exception(std::current_exception());
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017-2019 Gian-Carlo Pascutto
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#ifndef ANALYSISENGINE_H_INCLUDED
+#define ANALYSISENGINE_H_INCLUDED
+
+#include "config.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "GameState.h"
+#include "Network.h"
+#include "UCTSearch.h"
+
+/*
+    Analyzes many positions at once with independent searches that
+    share one Network, and so its cache and batched evaluation queue.
+
+    Jobs are taken by whichever search is free first. Jobs submitted on
+    the same stream are analyzed in order by the same search, so the
+    tree is reused when a stream follows a game move by move.
+*/
+class AnalysisEngine {
+public:
+    AnalysisEngine(Network & network, size_t searches,
+                   size_t threads_per_search);
+    // Finishes all submitted jobs.
+    ~AnalysisEngine();
+
+    std::future<AnalysisResult> submit(const GameState & state, int visits);
+    std::future<AnalysisResult> submit(const GameState & state, int visits,
+                                       size_t stream);
+
+    size_t get_search_count() const { return m_workers.size(); }
+
+private:
+    struct Job {
+        GameState state;
+        int visits;
+        std::promise<AnalysisResult> result;
+    };
+
+    void enqueue(std::deque<Job> & queue, Job && job);
+    void worker(size_t index, size_t threads);
+
+    Network & m_network;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condvar;
+    // Jobs that any search can take, and jobs for each stream.
+    std::deque<Job> m_jobs;
+    std::vector<std::deque<Job>> m_stream_jobs;
+    bool m_exit{false};
+};
+
+#endif
@@ -45,6 +45,8 @@
 #include "CPUPipe.h"
 #include "Network.h"
 #include "Im2Col.h"
+#include "Profiler.h"
+#include "Trace.h"
 
 #ifndef USE_BLAS
 // Eigen helpers
@@ -382,6 +384,9 @@ void batchnorm(const size_t channels,
 void CPUPipe::forward(const std::vector<float>& input,
                       std::vector<float>& output_pol,
                       std::vector<float>& output_val) {
+    PROFILE_PHASE(NN_FORWARD);
+    Trace::Span span("nn forward", 1);
+
     // Input convolution
     constexpr auto P = WINOGRAD_P;
     // Calculate output channels
@@ -0,0 +1,677 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#include "config.h"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "CompactBoard.h"
+#include "FullBoard.h"
+#include "Network.h"
+#include "Utils.h"
+#include "Zobrist.h"
+
+using namespace Utils;
+
+static_assert(CompactBoard::NUM_VERTICES == FastBoard::NUM_VERTICES,
+              "CompactBoard and FastBoard must agree on the vertices");
+
+// For every board size, the index of each vertex in the bit planes,
+// or -1 for the vertices off the board.
+using IndexTable = std::array<std::int16_t, FastBoard::NUM_VERTICES>;
+
+static std::vector<IndexTable> make_index_tables() {
+    auto tables = std::vector<IndexTable>(BOARD_SIZE + 1);
+    for (auto size = 0; size <= BOARD_SIZE; size++) {
+        auto& table = tables[size];
+        table.fill(-1);
+        for (auto y = 0; y < size; y++) {
+            for (auto x = 0; x < size; x++) {
+                table[(y + 1) * (size + 2) + x + 1] = x + y * BOARD_SIZE;
+            }
+        }
+    }
+    return tables;
+}
+
+static const auto s_index_tables = make_index_tables();
+
+constexpr int CompactBoard::NUM_VERTICES;
+constexpr int CompactBoard::NO_VERTEX;
+constexpr int CompactBoard::PASS;
+constexpr int CompactBoard::RESIGN;
+constexpr CompactBoard::vertex_t CompactBoard::BLACK;
+constexpr CompactBoard::vertex_t CompactBoard::WHITE;
+constexpr CompactBoard::vertex_t CompactBoard::EMPTY;
+constexpr CompactBoard::vertex_t CompactBoard::INVAL;
+constexpr std::uint16_t CompactBoard::NO_STRING;
+
+int CompactBoard::get_boardsize() const {
+    return m_boardsize;
+}
+
+int CompactBoard::get_vertex(int x, int y) const {
+    assert(x >= 0 && x < m_boardsize);
+    assert(y >= 0 && y < m_boardsize);
+
+    return ((y + 1) * (m_boardsize + 2)) + (x + 1);
+}
+
+std::pair<int, int> CompactBoard::get_xy(int vertex) const {
+    const auto x = (vertex % (m_boardsize + 2)) - 1;
+    const auto y = (vertex / (m_boardsize + 2)) - 1;
+
+    assert(x >= 0 && x < m_boardsize);
+    assert(y >= 0 && y < m_boardsize);
+
+    return std::make_pair(x, y);
+}
+
+int CompactBoard::get_index(int vertex) const {
+    const auto index = s_index_tables[m_boardsize][vertex];
+    assert(index >= 0);
+    return index;
+}
+
+CompactBoard::vertex_t CompactBoard::get_state(int vertex) const {
+    assert(vertex >= 0 && vertex < NUM_VERTICES);
+
+    const auto index = s_index_tables[m_boardsize][vertex];
+    if (index < 0) {
+        return INVAL;
+    }
+    if (m_stones[BLACK][index]) {
+        return BLACK;
+    } else if (m_stones[WHITE][index]) {
+        return WHITE;
+    }
+    return EMPTY;
+}
+
+CompactBoard::vertex_t CompactBoard::get_state(int x, int y) const {
+    return get_state(get_vertex(x, y));
+}
+
+void CompactBoard::set_state(int vertex, vertex_t content) {
+    assert(content >= BLACK && content <= EMPTY);
+
+    const auto index = get_index(vertex);
+    m_stones[BLACK][index] = (content == BLACK);
+    m_stones[WHITE][index] = (content == WHITE);
+}
+
+void CompactBoard::set_state(int x, int y, vertex_t content) {
+    set_state(get_vertex(x, y), content);
+}
+
+void CompactBoard::reset_board(int size) {
+    assert(size <= BOARD_SIZE);
+
+    m_boardsize = size;
+    m_tomove = BLACK;
+    m_prisoners[BLACK] = 0;
+    m_prisoners[WHITE] = 0;
+    m_stones[BLACK].reset();
+    m_stones[WHITE].reset();
+    m_parent.fill(NO_STRING);
+    m_libs.fill(0);
+
+    m_hash = calc_hash();
+    m_ko_hash = calc_ko_hash();
+    for (auto s = 0; s < NUM_SYMMETRIES; s++) {
+        m_symmetry_ko_hash[s] = calc_symmetry_ko_hash(s);
+    }
+}
+
+const CompactBoard::BoardMask& CompactBoard::get_on_board() const {
+    static const auto s_on_board = [] {
+        auto masks = std::array<BoardMask, BOARD_SIZE + 1>{};
+        for (auto size = 0; size <= BOARD_SIZE; size++) {
+            for (auto y = 0; y < size; y++) {
+                for (auto x = 0; x < size; x++) {
+                    masks[size].set(x + y * BOARD_SIZE);
+                }
+            }
+        }
+        return masks;
+    }();
+    return s_on_board[m_boardsize];
+}
+
+CompactBoard::BoardMask CompactBoard::get_empty_mask() const {
+    return get_on_board() & ~(m_stones[BLACK] | m_stones[WHITE]);
+}
+
+CompactBoard::BoardMask CompactBoard::get_string_mask(int index) const {
+    const auto& own = m_stones[m_stones[BLACK][index] ? BLACK : WHITE];
+    assert(own[index]);
+
+    auto string = BoardMask{};
+    string.set(index);
+    while (true) {
+        const auto grown = (string | FastBoard::get_neighbours(string)) & own;
+        if (grown == string) {
+            return string;
+        }
+        string = grown;
+    }
+}
+
+CompactBoard::BoardMask CompactBoard::get_liberties(
+    const BoardMask& string) const {
+    return FastBoard::get_neighbours(string) & get_empty_mask();
+}
+
+int CompactBoard::count_liberties(int vertex) const {
+    assert(get_state(vertex) == BLACK || get_state(vertex) == WHITE);
+    return m_libs[m_parent[get_index(vertex)]];
+}
+
+CompactBoard::BoardMask CompactBoard::get_string_stones(int vertex) const {
+    return get_string_mask(get_index(vertex));
+}
+
+CompactBoard::BoardMask CompactBoard::get_string_liberties(int vertex) const {
+    return get_liberties(get_string_stones(vertex));
+}
+
+int CompactBoard::count_pliberties(const int i) const {
+    const auto side = m_boardsize + 2;
+    auto liberties = 0;
+    for (const auto dir : {-side, 1, side, -1}) {
+        liberties += (get_state(i + dir) == EMPTY);
+    }
+    return liberties;
+}
+
+bool CompactBoard::is_suicide(int i, int color) const {
+    // If there are liberties next to us, it is never suicide
+    if (count_pliberties(i)) {
+        return false;
+    }
+
+    // If we get here, we played in a "hole" surrounded by stones
+    const auto side = m_boardsize + 2;
+    for (const auto dir : {-side, 1, side, -1}) {
+        const auto ai = i + dir;
+        const auto state = get_state(ai);
+        if (state == INVAL) {
+            continue;
+        }
+        const auto libs = count_liberties(ai);
+        if (state == color) {
+            if (libs > 1) {
+                // connecting to live group = not suicide
+                return false;
+            }
+        } else if (libs <= 1) {
+            // killing neighbour = not suicide
+            return false;
+        }
+    }
+
+    // We played in a hole, friendlies had one liberty at most and
+    // we did not kill anything. So we killed ourselves.
+    return true;
+}
+
+bool CompactBoard::is_eye(const int color, const int i) const {
+    const auto side = m_boardsize + 2;
+
+    // Need 4 neighbors of our color, counting the edge as both colors.
+    for (const auto dir : {-side, 1, side, -1}) {
+        const auto state = get_state(i + dir);
+        if (state != color && state != INVAL) {
+            return false;
+        }
+    }
+
+    // 2 or more diagonals taken
+    // 1 for side groups
+    int colorcount[4] = {0, 0, 0, 0};
+    for (const auto dir : {-1 - side, 1 - side, -1 + side, 1 + side}) {
+        colorcount[get_state(i + dir)]++;
+    }
+
+    if (colorcount[INVAL] == 0) {
+        if (colorcount[!color] > 1) {
+            return false;
+        }
+    } else {
+        if (colorcount[!color]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+CompactBoard::BoardMask CompactBoard::get_legal_mask(int color) const {
+    // A point next to an empty point is never suicide, so only the
+    // ones surrounded by stones or the edge need a closer look.
+    const auto empty = get_empty_mask();
+    const auto holes = empty & ~FastBoard::get_neighbours(empty);
+
+    auto legal = empty;
+    if (holes.any()) {
+        for (auto i = 0; i < NUM_INTERSECTIONS; i++) {
+            if (holes[i]) {
+                const auto vertex = get_vertex(i % BOARD_SIZE, i / BOARD_SIZE);
+                if (is_suicide(vertex, color)) {
+                    legal.reset(i);
+                }
+            }
+        }
+    }
+    return legal;
+}
+
+int CompactBoard::remove_string_root(int root, int color) {
+    auto removed = 0;
+    const auto side = m_boardsize + 2;
+    for (auto i = 0; i < NUM_INTERSECTIONS; i++) {
+        if (m_parent[i] != root) {
+            continue;
+        }
+        removed++;
+        m_stones[color].reset(i);
+        const auto vertex = get_vertex(i % BOARD_SIZE, i / BOARD_SIZE);
+        m_hash    ^= Zobrist::zobrist[color][vertex];
+        m_ko_hash ^= Zobrist::zobrist[color][vertex];
+        m_hash    ^= Zobrist::zobrist[EMPTY][vertex];
+        m_ko_hash ^= Zobrist::zobrist[EMPTY][vertex];
+        update_symmetry_ko_hashes(vertex, color);
+        m_parent[i] = NO_STRING;
+
+        // The point is a new liberty of every string of the other
+        // color next to it, counted once per string.
+        auto seen = std::array<int, 4>{};
+        auto nbr_count = 0;
+        for (const auto dir : {-side, 1, side, -1}) {
+            const auto ai = vertex + dir;
+            if (get_state(ai) != !color) {
+                continue;
+            }
+            const auto nbr_root = m_parent[get_index(ai)];
+            if (std::find(begin(seen), begin(seen) + nbr_count, nbr_root)
+                == begin(seen) + nbr_count) {
+                seen[nbr_count++] = nbr_root;
+                m_libs[nbr_root]++;
+            }
+        }
+    }
+    return removed;
+}
+
+int CompactBoard::remove_string(int i) {
+    const auto color = get_state(i);
+    assert(color == BLACK || color == WHITE);
+    return remove_string_root(m_parent[get_index(i)], color);
+}
+
+// Whether the empty point at vertex is next to the string at root,
+// other than through the stone at except.
+bool CompactBoard::is_liberty_of(int vertex, int root, int except) const {
+    const auto side = m_boardsize + 2;
+    for (const auto dir : {-side, 1, side, -1}) {
+        const auto ai = vertex + dir;
+        if (ai != except && (get_state(ai) == BLACK || get_state(ai) == WHITE)
+            && m_parent[get_index(ai)] == root) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int CompactBoard::update_board(const int color, const int i) {
+    assert(i != PASS);
+    assert(get_state(i) == EMPTY);
+
+    const auto index = get_index(i);
+    const auto side = m_boardsize + 2;
+
+    /* did we play into an opponent eye? */
+    auto eyeplay = true;
+    for (const auto dir : {-side, 1, side, -1}) {
+        const auto state = get_state(i + dir);
+        eyeplay &= (state == !color || state == INVAL);
+    }
+
+    m_hash    ^= Zobrist::zobrist[EMPTY][i];
+    m_ko_hash ^= Zobrist::zobrist[EMPTY][i];
+    m_stones[color].set(index);
+    m_hash    ^= Zobrist::zobrist[color][i];
+    m_ko_hash ^= Zobrist::zobrist[color][i];
+    update_symmetry_ko_hashes(i, color);
+
+    /* the strings next to us lose a liberty, once each */
+    auto own = std::array<int, 4>{};
+    auto own_count = 0;
+    auto theirs = std::array<int, 4>{};
+    auto theirs_count = 0;
+    for (const auto dir : {-side, 1, side, -1}) {
+        const auto ai = i + dir;
+        const auto state = get_state(ai);
+        if (state != BLACK && state != WHITE) {
+            continue;
+        }
+        const auto root = m_parent[get_index(ai)];
+        auto& roots = (state == color) ? own : theirs;
+        auto& count = (state == color) ? own_count : theirs_count;
+        if (std::find(begin(roots), begin(roots) + count, root)
+            == begin(roots) + count) {
+            roots[count++] = root;
+            m_libs[root]--;
+        }
+    }
+
+    /* join our strings, keeping the root of the first one */
+    const auto root = own_count ? own[0] : index;
+    m_parent[index] = root;
+    if (own_count == 0) {
+        m_libs[root] = count_pliberties(i);
+    } else if (own_count == 1) {
+        for (const auto dir : {-side, 1, side, -1}) {
+            const auto ai = i + dir;
+            if (get_state(ai) == EMPTY && !is_liberty_of(ai, root, i)) {
+                m_libs[root]++;
+            }
+        }
+    } else {
+        auto string = BoardMask{};
+        for (auto j = 0; j < NUM_INTERSECTIONS; j++) {
+            auto& parent = m_parent[j];
+            if (std::find(begin(own) + 1, begin(own) + own_count, parent)
+                != begin(own) + own_count) {
+                parent = root;
+            }
+            if (parent == root) {
+                string.set(j);
+            }
+        }
+        m_libs[root] = get_liberties(string).count();
+    }
+
+    auto captured_stones = 0;
+    int captured_vtx = NO_VERTEX;
+
+    for (const auto dir : {-side, 1, side, -1}) {
+        const auto ai = i + dir;
+        if (get_state(ai) == !color && m_libs[m_parent[get_index(ai)]] == 0) {
+            captured_stones +=
+                remove_string_root(m_parent[get_index(ai)], !color);
+            captured_vtx = ai;
+        }
+    }
+
+    m_hash ^= Zobrist::zobrist_pris[color][m_prisoners[color]];
+    m_prisoners[color] += captured_stones;
+    m_hash ^= Zobrist::zobrist_pris[color][m_prisoners[color]];
+
+    /* check whether we still live (i.e. detect suicide) */
+    if (m_libs[root] == 0) {
+        assert(captured_stones == 0);
+        remove_string_root(root, color);
+    }
+
+    /* check for possible simple ko */
+    if (captured_stones == 1 && eyeplay) {
+        assert(get_state(captured_vtx) == EMPTY
+                && !is_suicide(captured_vtx, !color));
+        return captured_vtx;
+    }
+
+    // No ko
+    return NO_VERTEX;
+}
+
+int CompactBoard::calc_reach_color(int color) const {
+    return FastBoard::count_reach(m_stones[color], get_empty_mask());
+}
+
+// Needed for scoring passed out games not in MC playouts
+float CompactBoard::area_score(float komi) const {
+    auto white = calc_reach_color(WHITE);
+    auto black = calc_reach_color(BLACK);
+    return black - white - komi;
+}
+
+int CompactBoard::get_prisoners(int side) const {
+    assert(side == WHITE || side == BLACK);
+
+    return m_prisoners[side];
+}
+
+int CompactBoard::get_to_move() const {
+    return m_tomove;
+}
+
+bool CompactBoard::black_to_move() const {
+    return m_tomove == BLACK;
+}
+
+bool CompactBoard::white_to_move() const {
+    return m_tomove == WHITE;
+}
+
+void CompactBoard::set_to_move(int tomove) {
+    if (m_tomove != tomove) {
+        m_hash ^= Zobrist::zobrist_blacktomove;
+    }
+    m_tomove = tomove;
+}
+
+std::string CompactBoard::move_to_text(int move) const {
+    return FastBoard::move_to_text(move, m_boardsize);
+}
+
+int CompactBoard::text_to_move(std::string move) const {
+    return FastBoard::text_to_move(move, m_boardsize);
+}
+
+std::string CompactBoard::move_to_text_sgf(int move) const {
+    return FastBoard::move_to_text_sgf(move, m_boardsize);
+}
+
+std::string CompactBoard::get_string(int vertex) const {
+    std::string result;
+
+    const auto string = get_string_mask(get_index(vertex));
+    for (auto i = 0; i < NUM_INTERSECTIONS; i++) {
+        if (string[i]) {
+            result += move_to_text(get_vertex(i % BOARD_SIZE, i / BOARD_SIZE))
+                    + " ";
+        }
+    }
+
+    // eat last space
+    assert(result.size() > 0);
+    result.resize(result.size() - 1);
+
+    return result;
+}
+
+std::string CompactBoard::get_stone_list() const {
+    std::string result;
+
+    for (int i = 0; i < m_boardsize; i++) {
+        for (int j = 0; j < m_boardsize; j++) {
+            int vertex = get_vertex(i, j);
+
+            if (get_state(vertex) != EMPTY) {
+                result += move_to_text(vertex) + " ";
+            }
+        }
+    }
+
+    // eat final space, if any.
+    if (result.size() > 0) {
+        result.resize(result.size() - 1);
+    }
+
+    return result;
+}
+
+void CompactBoard::display_board(int lastmove) {
+    int boardsize = get_boardsize();
+
+    myprintf("\n   ");
+    FastBoard::print_columns(boardsize);
+    for (int j = boardsize-1; j >= 0; j--) {
+        myprintf("%2d", j+1);
+        if (lastmove == get_vertex(0, j))
+            myprintf("(");
+        else
+            myprintf(" ");
+        for (int i = 0; i < boardsize; i++) {
+            if (get_state(i,j) == WHITE) {
+                myprintf("O");
+            } else if (get_state(i,j) == BLACK)  {
+                myprintf("X");
+            } else if (FastBoard::starpoint(boardsize, i, j)) {
+                myprintf("+");
+            } else {
+                myprintf(".");
+            }
+            if (lastmove == get_vertex(i, j)) myprintf(")");
+            else if (i != boardsize-1 && lastmove == get_vertex(i, j)+1) myprintf("(");
+            else myprintf(" ");
+        }
+        myprintf("%2d\n", j+1);
+    }
+    myprintf("   ");
+    FastBoard::print_columns(boardsize);
+    myprintf("\n");
+
+    myprintf("Hash: %llX Ko-Hash: %llX\n\n", get_hash(), get_ko_hash());
+}
+
+std::uint64_t CompactBoard::calc_ko_hash() const {
+    auto res = Zobrist::zobrist_empty;
+
+    for (auto y = 0; y < m_boardsize; y++) {
+        for (auto x = 0; x < m_boardsize; x++) {
+            const auto vertex = get_vertex(x, y);
+            res ^= Zobrist::zobrist[get_state(vertex)][vertex];
+        }
+    }
+
+    /* Tromp-Taylor has positional superko */
+    return res;
+}
+
+template<class Function>
+std::uint64_t CompactBoard::calc_hash(int komove, Function transform) const {
+    auto res = Zobrist::zobrist_empty;
+
+    for (auto y = 0; y < m_boardsize; y++) {
+        for (auto x = 0; x < m_boardsize; x++) {
+            const auto vertex = get_vertex(x, y);
+            res ^= Zobrist::zobrist[get_state(vertex)][transform(vertex)];
+        }
+    }
+
+    /* prisoner hashing is rule set dependent */
+    res ^= Zobrist::zobrist_pris[0][m_prisoners[0]];
+    res ^= Zobrist::zobrist_pris[1][m_prisoners[1]];
+
+    if (m_tomove == BLACK) {
+        res ^= Zobrist::zobrist_blacktomove;
+    }
+
+    res ^= Zobrist::zobrist_ko[transform(komove)];
+
+    return res;
+}
+
+std::uint64_t CompactBoard::calc_hash(int komove) const {
+    return calc_hash(komove, [](const auto vertex) { return vertex; });
+}
+
+std::uint64_t CompactBoard::calc_symmetry_hash(int komove, int symmetry) const {
+    return calc_hash(komove, [this, symmetry](const auto vertex) {
+        if (vertex == NO_VERTEX) {
+            return NO_VERTEX;
+        } else {
+            const auto newvtx = Network::get_symmetry(get_xy(vertex), symmetry, m_boardsize);
+            return get_vertex(newvtx.first, newvtx.second);
+        }
+    });
+}
+
+std::uint64_t CompactBoard::calc_symmetry_ko_hash(int symmetry) const {
+    auto res = Zobrist::zobrist_empty;
+
+    for (auto y = 0; y < m_boardsize; y++) {
+        for (auto x = 0; x < m_boardsize; x++) {
+            const auto vertex = get_vertex(x, y);
+            res ^= Zobrist::zobrist[get_state(vertex)][
+                FullBoard::get_symmetry_vertex(m_boardsize, symmetry, vertex)];
+        }
+    }
+
+    return res;
+}
+
+void CompactBoard::update_symmetry_ko_hashes(int vertex, int color) {
+    for (auto s = 0; s < NUM_SYMMETRIES; s++) {
+        const auto newvtx =
+            FullBoard::get_symmetry_vertex(m_boardsize, s, vertex);
+        m_symmetry_ko_hash[s] ^= Zobrist::zobrist[EMPTY][newvtx];
+        m_symmetry_ko_hash[s] ^= Zobrist::zobrist[color][newvtx];
+    }
+}
+
+std::uint64_t CompactBoard::get_symmetry_hash(int komove, int symmetry) const {
+    assert(symmetry >= 0 && symmetry < NUM_SYMMETRIES);
+    auto res = m_symmetry_ko_hash[symmetry];
+
+    /* prisoner hashing is rule set dependent */
+    res ^= Zobrist::zobrist_pris[0][m_prisoners[0]];
+    res ^= Zobrist::zobrist_pris[1][m_prisoners[1]];
+
+    if (m_tomove == BLACK) {
+        res ^= Zobrist::zobrist_blacktomove;
+    }
+
+    res ^= Zobrist::zobrist_ko[
+        FullBoard::get_symmetry_vertex(m_boardsize, symmetry, komove)];
+
+    return res;
+}
+
+std::uint64_t CompactBoard::get_hash() const {
+    return m_hash;
+}
+
+std::uint64_t CompactBoard::get_ko_hash() const {
+    return m_ko_hash;
+}
@@ -0,0 +1,143 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#ifndef COMPACTBOARD_H_INCLUDED
+#define COMPACTBOARD_H_INCLUDED
+
+#include "config.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "FastBoard.h"
+
+/*
+    A board with the same interface as FullBoard that stores the stones
+    as one bit plane per color, so that copying it is cheap. Instead of
+    FullBoard's linked lists and neighbour counts it keeps, for every
+    stone, the point its string is rooted at, and for every string its
+    number of liberties. The stones and liberties of a string are found
+    by flood filling the planes when needed. Build with USE_COMPACT_BOARD
+    to use it for the game states.
+*/
+class CompactBoard {
+    friend class FastState;
+public:
+    using vertex_t = FastBoard::vertex_t;
+    using BoardMask = FastBoard::BoardMask;
+
+    static constexpr int NUM_VERTICES = FastBoard::NUM_VERTICES;
+    static constexpr int NO_VERTEX = FastBoard::NO_VERTEX;
+    static constexpr int PASS = FastBoard::PASS;
+    static constexpr int RESIGN = FastBoard::RESIGN;
+    static constexpr vertex_t BLACK = FastBoard::BLACK;
+    static constexpr vertex_t WHITE = FastBoard::WHITE;
+    static constexpr vertex_t EMPTY = FastBoard::EMPTY;
+    static constexpr vertex_t INVAL = FastBoard::INVAL;
+
+    int get_boardsize() const;
+    vertex_t get_state(int x, int y) const;
+    vertex_t get_state(int vertex) const;
+    int get_vertex(int x, int y) const;
+    void set_state(int x, int y, vertex_t content);
+    void set_state(int vertex, vertex_t content);
+    std::pair<int, int> get_xy(int vertex) const;
+    int get_index(int vertex) const;
+
+    bool is_suicide(int i, int color) const;
+    int count_pliberties(const int i) const;
+    bool is_eye(const int color, const int vtx) const;
+
+    int count_liberties(int vertex) const;
+    BoardMask get_string_stones(int vertex) const;
+    BoardMask get_string_liberties(int vertex) const;
+
+    BoardMask get_empty_mask() const;
+    BoardMask get_legal_mask(int color) const;
+
+    float area_score(float komi) const;
+
+    int get_prisoners(int side) const;
+    bool black_to_move() const;
+    bool white_to_move() const;
+    int get_to_move() const;
+    void set_to_move(int tomove);
+
+    std::string move_to_text(int move) const;
+    int text_to_move(std::string move) const;
+    std::string move_to_text_sgf(int move) const;
+    std::string get_stone_list() const;
+    std::string get_string(int vertex) const;
+
+    void reset_board(int size);
+    void display_board(int lastmove = -1);
+
+    int remove_string(int i);
+    int update_board(const int color, const int i);
+
+    std::uint64_t get_hash() const;
+    std::uint64_t get_ko_hash() const;
+
+    std::uint64_t calc_hash(int komove = NO_VERTEX) const;
+    std::uint64_t calc_symmetry_hash(int komove, int symmetry) const;
+    std::uint64_t calc_ko_hash() const;
+    std::uint64_t get_symmetry_hash(int komove, int symmetry) const;
+
+    std::uint64_t m_hash;
+    std::uint64_t m_ko_hash;
+
+private:
+    static constexpr auto NUM_SYMMETRIES = 8;
+    // Root of the points without a stone.
+    static constexpr std::uint16_t NO_STRING = NUM_INTERSECTIONS;
+
+    const BoardMask& get_on_board() const;
+    BoardMask get_string_mask(int index) const;
+    BoardMask get_liberties(const BoardMask& string) const;
+    bool is_liberty_of(int vertex, int root, int except) const;
+    int remove_string_root(int root, int color);
+    int calc_reach_color(int color) const;
+
+    template<class Function>
+    std::uint64_t calc_hash(int komove, Function transform) const;
+    std::uint64_t calc_symmetry_ko_hash(int symmetry) const;
+    void update_symmetry_ko_hashes(int vertex, int color);
+
+    std::array<BoardMask, 2> m_stones;   /* stones per color */
+    std::array<std::uint16_t, NUM_INTERSECTIONS> m_parent; /* string roots */
+    std::array<std::uint16_t, NUM_INTERSECTIONS> m_libs;   /* by root */
+    std::array<std::uint64_t, NUM_SYMMETRIES> m_symmetry_ko_hash;
+    std::array<int, 2> m_prisoners;      /* prisoners per color */
+    int m_tomove;
+    int m_boardsize;
+};
+
+#endif
@@ -34,7 +34,6 @@
 #include <algorithm>
 #include <array>
 #include <iostream>
-#include <queue>
 #include <sstream>
 #include <string>
 
@@ -58,6 +57,18 @@ const std::array<FastBoard::vertex_t, 4> FastBoard::s_cinvert = {
     WHITE, BLACK, EMPTY, INVAL
 };
 
+// All intersections except those in column x.
+static FastBoard::BoardMask all_but_column(int x) {
+    auto mask = FastBoard::BoardMask{};
+    for (auto i = 0; i < NUM_INTERSECTIONS; i++) {
+        mask[i] = (i % BOARD_SIZE != x);
+    }
+    return mask;
+}
+
+static const auto s_not_first_column = all_but_column(0);
+static const auto s_not_last_column = all_but_column(BOARD_SIZE - 1);
+
 int FastBoard::get_boardsize() const {
     return m_boardsize;
 }
@@ -87,6 +98,11 @@ std::pair<int, int> FastBoard::get_xy(int vertex) const {
     return std::make_pair(x, y);
 }
 
+int FastBoard::get_index(int vertex) const {
+    const auto xy = get_xy(vertex);
+    return xy.first + xy.second * BOARD_SIZE;
+}
+
 FastBoard::vertex_t FastBoard::get_state(int vertex) const {
     assert(vertex >= 0 && vertex < NUM_VERTICES);
     assert(vertex >= 0 && vertex < m_numvertices);
@@ -118,6 +134,7 @@ void FastBoard::reset_board(int size) {
     m_prisoners[BLACK] = 0;
     m_prisoners[WHITE] = 0;
     m_empty_cnt = 0;
+    m_empty_mask.reset();
 
     m_dirs[0] = -m_sidevertices;
     m_dirs[1] = +1;
@@ -137,6 +154,7 @@ void FastBoard::reset_board(int size) {
             m_state[vertex]           = EMPTY;
             m_empty_idx[vertex]       = m_empty_cnt;
             m_empty[m_empty_cnt++]    = vertex;
+            m_empty_mask.set(get_index(vertex));
 
             if (i == 0 || i == size - 1) {
                 m_neighbours[vertex] += (1 << (NBR_SHIFT * BLACK))
@@ -192,10 +210,73 @@ bool FastBoard::is_suicide(int i, int color) const {
     return true;
 }
 
+FastBoard::BoardMask FastBoard::get_empty_mask() const {
+    return m_empty_mask;
+}
+
+FastBoard::BoardMask FastBoard::get_neighbours(const BoardMask& mask) {
+    return ((mask << 1) & s_not_first_column)
+         | ((mask >> 1) & s_not_last_column)
+         | (mask << BOARD_SIZE)
+         | (mask >> BOARD_SIZE);
+}
+
+FastBoard::BoardMask FastBoard::get_legal_mask(int color) const {
+    // A point next to an empty point is never suicide, so only the
+    // ones surrounded by stones or the edge need a closer look.
+    const auto& empty = m_empty_mask;
+    const auto holes = empty & ~get_neighbours(empty);
+
+    auto legal = empty;
+    if (holes.any()) {
+        for (auto i = 0; i < NUM_INTERSECTIONS; i++) {
+            if (holes[i]) {
+                const auto vertex = get_vertex(i % BOARD_SIZE, i / BOARD_SIZE);
+                if (is_suicide(vertex, color)) {
+                    legal.reset(i);
+                }
+            }
+        }
+    }
+    return legal;
+}
+
 int FastBoard::count_pliberties(const int i) const {
     return count_neighbours(EMPTY, i);
 }
 
+int FastBoard::count_liberties(int vertex) const {
+    assert(m_state[vertex] == BLACK || m_state[vertex] == WHITE);
+    return m_libs[m_parent[vertex]];
+}
+
+FastBoard::BoardMask FastBoard::get_string_stones(int vertex) const {
+    assert(m_state[vertex] == BLACK || m_state[vertex] == WHITE);
+    auto stones = BoardMask{};
+    auto pos = vertex;
+    do {
+        stones.set(get_index(pos));
+        pos = m_next[pos];
+    } while (pos != vertex);
+    return stones;
+}
+
+FastBoard::BoardMask FastBoard::get_string_liberties(int vertex) const {
+    assert(m_state[vertex] == BLACK || m_state[vertex] == WHITE);
+    auto liberties = BoardMask{};
+    auto pos = vertex;
+    do {
+        for (auto k = 0; k < 4; k++) {
+            const auto ai = pos + m_dirs[k];
+            if (m_state[ai] == EMPTY) {
+                liberties.set(get_index(ai));
+            }
+        }
+        pos = m_next[pos];
+    } while (pos != vertex);
+    return liberties;
+}
+
 // count neighbours of color c at vertex v
 // the border of the board has fake neighours of both colors
 int FastBoard::count_neighbours(const int c, const int v) const {
@@ -254,35 +335,28 @@ void FastBoard::remove_neighbour(const int vtx, const int color) {
     }
 }
 
-int FastBoard::calc_reach_color(int color) const {
-    auto reachable = 0;
-    auto bd = std::vector<bool>(m_numvertices, false);
-    auto open = std::queue<int>();
-    for (auto i = 0; i < m_boardsize; i++) {
-        for (auto j = 0; j < m_boardsize; j++) {
-            auto vertex = get_vertex(i, j);
-            if (m_state[vertex] == color) {
-                reachable++;
-                bd[vertex] = true;
-                open.push(vertex);
-            }
+int FastBoard::count_reach(BoardMask stones, const BoardMask& empty) {
+    // Grow the stones into the empty points around them a step at a
+    // time, a whole board at once, until nothing changes.
+    while (true) {
+        const auto grown = stones | (get_neighbours(stones) & empty);
+        if (grown == stones) {
+            return int(stones.count());
         }
+        stones = grown;
     }
-    while (!open.empty()) {
-        /* colored field, spread */
-        auto vertex = open.front();
-        open.pop();
+}
 
-        for (auto k = 0; k < 4; k++) {
-            auto neighbor = vertex + m_dirs[k];
-            if (!bd[neighbor] && m_state[neighbor] == EMPTY) {
-                reachable++;
-                bd[neighbor] = true;
-                open.push(neighbor);
+int FastBoard::calc_reach_color(int color) const {
+    auto stones = BoardMask{};
+    for (auto i = 0; i < m_boardsize; i++) {
+        for (auto j = 0; j < m_boardsize; j++) {
+            if (m_state[get_vertex(i, j)] == color) {
+                stones.set(i + j * BOARD_SIZE);
             }
         }
     }
-    return reachable;
+    return count_reach(stones, m_empty_mask);
 }
 
 // Needed for scoring passed out games not in MC playouts
@@ -296,7 +370,7 @@ void FastBoard::display_board(int lastmove) {
     int boardsize = get_boardsize();
 
     myprintf("\n   ");
-    print_columns();
+    print_columns(boardsize);
     for (int j = boardsize-1; j >= 0; j--) {
         myprintf("%2d", j+1);
         if (lastmove == get_vertex(0, j))
@@ -320,12 +394,12 @@ void FastBoard::display_board(int lastmove) {
         myprintf("%2d\n", j+1);
     }
     myprintf("   ");
-    print_columns();
+    print_columns(boardsize);
     myprintf("\n");
 }
 
-void FastBoard::print_columns() {
-    for (int i = 0; i < get_boardsize(); i++) {
+void FastBoard::print_columns(int boardsize) {
+    for (int i = 0; i < boardsize; i++) {
         if (i < 25) {
             myprintf("%c ", (('a' + i < 'i') ? 'a' + i : 'a' + i + 1));
         } else {
@@ -342,6 +416,7 @@ void FastBoard::merge_strings(const int ip, const int aip) {
     m_stones[ip] += m_stones[aip];
 
     /* loop over stones, update parents */
+    const auto color = m_state[ip];
     int newpos = aip;
 
     do {
@@ -350,6 +425,12 @@ void FastBoard::merge_strings(const int ip, const int aip) {
             int ai = newpos + m_dirs[k];
             // for each liberty, check if it is not shared
             if (m_state[ai] == EMPTY) {
+                // if newpos is its only friendly neighbour (the edge
+                // counts as both colors), it can't be shared
+                if (count_neighbours(color, ai) == 1) {
+                    m_libs[ip]++;
+                    continue;
+                }
                 // find liberty neighbors
                 bool found = false;
                 for (int kk = 0; kk < 4; kk++) {
@@ -414,22 +495,27 @@ bool FastBoard::is_eye(const int color, const int i) const {
 }
 
 std::string FastBoard::move_to_text(int move) const {
+    return move_to_text(move, m_boardsize);
+}
+
+std::string FastBoard::move_to_text(int move, int boardsize) {
     std::ostringstream result;
 
-    int column = move % m_sidevertices;
-    int row = move / m_sidevertices;
+    const auto sidevertices = boardsize + 2;
+    int column = move % sidevertices;
+    int row = move / sidevertices;
 
     column--;
     row--;
 
     assert(move == FastBoard::PASS
            || move == FastBoard::RESIGN
-           || (row >= 0 && row < m_boardsize));
+           || (row >= 0 && row < boardsize));
     assert(move == FastBoard::PASS
            || move == FastBoard::RESIGN
-           || (column >= 0 && column < m_boardsize));
+           || (column >= 0 && column < boardsize));
 
-    if (move >= 0 && move <= m_numvertices) {
+    if (move >= 0 && move <= sidevertices * sidevertices) {
         result << static_cast<char>(column < 8 ? 'A' + column : 'A' + column + 1);
         result << (row + 1);
     } else if (move == FastBoard::PASS) {
@@ -444,6 +530,10 @@ std::string FastBoard::move_to_text(int move) const {
 }
 
 int FastBoard::text_to_move(std::string move) const {
+    return text_to_move(move, m_boardsize);
+}
+
+int FastBoard::text_to_move(std::string move, int boardsize) {
     transform(cbegin(move), cend(move), begin(move), tolower);
 
     if (move == "pass") {
@@ -464,33 +554,39 @@ int FastBoard::text_to_move(std::string move) const {
     parsestream >> row;
     --row;
 
-    if (row >= m_boardsize || column >= m_boardsize) {
+    if (row >= boardsize || column >= boardsize) {
         return NO_VERTEX;
     }
 
-    return get_vertex(column, row);
+    assert(row >= 0 && column >= 0);
+    return (row + 1) * (boardsize + 2) + (column + 1);
 }
 
 std::string FastBoard::move_to_text_sgf(int move) const {
+    return move_to_text_sgf(move, m_boardsize);
+}
+
+std::string FastBoard::move_to_text_sgf(int move, int boardsize) {
     std::ostringstream result;
 
-    int column = move % m_sidevertices;
-    int row = move / m_sidevertices;
+    const auto sidevertices = boardsize + 2;
+    int column = move % sidevertices;
+    int row = move / sidevertices;
 
     column--;
     row--;
 
     assert(move == FastBoard::PASS
            || move == FastBoard::RESIGN
-           || (row >= 0 && row < m_boardsize));
+           || (row >= 0 && row < boardsize));
     assert(move == FastBoard::PASS
            || move == FastBoard::RESIGN
-           || (column >= 0 && column < m_boardsize));
+           || (column >= 0 && column < boardsize));
 
     // SGF inverts rows
-    row = m_boardsize - row - 1;
+    row = boardsize - row - 1;
 
-    if (move >= 0 && move <= m_numvertices) {
+    if (move >= 0 && move <= sidevertices * sidevertices) {
         if (column <= 25) {
             result << static_cast<char>('a' + column);
         } else {
@@ -33,6 +33,7 @@
 #include "config.h"
 
 #include <array>
+#include <bitset>
 #include <queue>
 #include <string>
 #include <utility>
@@ -73,6 +74,12 @@ public:
         BLACK = 0, WHITE = 1, EMPTY = 2, INVAL = 3
     };
 
+    /*
+        one bit per intersection, indexed like the network policy
+        output (x + y * BOARD_SIZE)
+    */
+    using BoardMask = std::bitset<NUM_INTERSECTIONS>;
+
     int get_boardsize() const;
     vertex_t get_state(int x, int y) const;
     vertex_t get_state(int vertex) const ;
@@ -80,11 +87,26 @@ public:
     void set_state(int x, int y, vertex_t content);
     void set_state(int vertex, vertex_t content);
     std::pair<int, int> get_xy(int vertex) const;
+    int get_index(int vertex) const;
 
     bool is_suicide(int i, int color) const;
     int count_pliberties(const int i) const;
     bool is_eye(const int color, const int vtx) const;
 
+    // The string of stones at vertex and its liberties.
+    int count_liberties(int vertex) const;
+    BoardMask get_string_stones(int vertex) const;
+    BoardMask get_string_liberties(int vertex) const;
+
+    BoardMask get_empty_mask() const;
+    // Empty intersections that are not suicide for color.
+    BoardMask get_legal_mask(int color) const;
+    // Intersections next to those in mask. On boards smaller than
+    // BOARD_SIZE this includes points off the board.
+    static BoardMask get_neighbours(const BoardMask& mask);
+    // Number of points in stones plus the empty points they reach.
+    static int count_reach(BoardMask stones, const BoardMask& empty);
+
     float area_score(float komi) const;
 
     int get_prisoners(int side) const;
@@ -105,6 +127,12 @@ public:
     static bool starpoint(int size, int point);
     static bool starpoint(int size, int x, int y);
 
+    // Move text conversions, which only depend on the board size.
+    static std::string move_to_text(int move, int boardsize);
+    static int text_to_move(std::string move, int boardsize);
+    static std::string move_to_text_sgf(int move, int boardsize);
+    static void print_columns(int boardsize);
+
 protected:
     /*
         bit masks to detect eyes on neighbors
@@ -123,6 +151,7 @@ protected:
     std::array<unsigned short, NUM_VERTICES>   m_empty;      /* empty intersections */
     std::array<unsigned short, NUM_VERTICES>   m_empty_idx;  /* intersection indices */
     int m_empty_cnt;                                         /* count of empties */
+    BoardMask m_empty_mask;                                  /* empties by index */
 
     int m_tomove;
     int m_numvertices;
@@ -136,7 +165,6 @@ protected:
     void merge_strings(const int ip, const int aip);
     void add_neighbour(const int i, const int color);
     void remove_neighbour(const int i, const int color);
-    void print_columns();
 };
 
 #endif
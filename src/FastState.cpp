@@ -82,6 +82,17 @@ bool FastState::is_move_legal(int color, int vertex) const {
                       !board.is_suicide(vertex, color)));
 }
 
+FastBoard::BoardMask FastState::get_legal_moves(int color) const {
+    auto legal = board.get_legal_mask(color);
+    if (m_komove != FastBoard::NO_VERTEX) {
+        legal.reset(board.get_index(m_komove));
+    }
+    if (cfg_analyze_tags.has_move_restrictions()) {
+        legal &= cfg_analyze_tags.get_allowed_mask(color, m_movenum);
+    }
+    return legal;
+}
+
 void FastState::play_move(int vertex) {
     play_move(board.m_tomove, vertex);
 }
@@ -177,5 +188,5 @@ int FastState::get_handicap() const {
 }
 
 std::uint64_t FastState::get_symmetry_hash(int symmetry) const {
-    return board.calc_symmetry_hash(m_komove, symmetry);
+    return board.get_symmetry_hash(m_komove, symmetry);
 }
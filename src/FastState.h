@@ -45,6 +45,8 @@ public:
 
     void play_move(int vertex);
     bool is_move_legal(int color, int vertex) const;
+    // Legal moves on the board, without pass and resign.
+    FastBoard::BoardMask get_legal_moves(int color) const;
 
     void set_komi(float komi);
     float get_komi() const;
@@ -64,7 +66,7 @@ public:
     void display_state();
     std::string move_to_text(int move);
 
-    FullBoard board;
+    GameBoard board;
 
     float m_komi;
     int m_handicap;
@@ -53,6 +53,12 @@ public:
         std::vector<float> m_conv_val_b;
     };
 
+    // Forward passes run so far and the positions evaluated by them.
+    struct BatchStats {
+        size_t batches{0};
+        size_t positions{0};
+    };
+
     virtual ~ForwardPipe() = default;
 
     virtual void initialize(const int channels) = 0;
@@ -64,6 +70,8 @@ public:
                               unsigned int channels,
                               unsigned int outputs,
                               std::shared_ptr<const ForwardPipeWeights> weights) = 0;
+    // Pipes that don't batch evaluations report no batches.
+    virtual BatchStats get_batch_stats() const { return {}; }
 };
 
 #endif
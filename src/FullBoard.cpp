@@ -31,6 +31,7 @@
 
 #include <array>
 #include <cassert>
+#include <vector>
 
 #include "FullBoard.h"
 #include "Network.h"
@@ -39,14 +40,61 @@
 
 using namespace Utils;
 
+static_assert(FullBoard::NUM_SYMMETRIES == Network::NUM_SYMMETRIES,
+              "FullBoard and Network must agree on the symmetries");
+
+// For every board size, the vertex each vertex maps to under each
+// symmetry. Vertices off the board map to themselves.
+using SymmetryTable = std::array<std::array<std::uint16_t, FastBoard::NUM_VERTICES>,
+                                 FullBoard::NUM_SYMMETRIES>;
+
+static std::vector<SymmetryTable> make_symmetry_tables() {
+    auto tables = std::vector<SymmetryTable>(BOARD_SIZE + 1);
+    for (auto size = 1; size <= BOARD_SIZE; size++) {
+        const auto sidevertices = size + 2;
+        for (auto s = 0; s < FullBoard::NUM_SYMMETRIES; s++) {
+            auto& table = tables[size][s];
+            for (auto v = 0; v < FastBoard::NUM_VERTICES; v++) {
+                table[v] = v;
+            }
+            for (auto y = 0; y < size; y++) {
+                for (auto x = 0; x < size; x++) {
+                    const auto newvtx = Network::get_symmetry({x, y}, s, size);
+                    table[(y + 1) * sidevertices + x + 1] =
+                        (newvtx.second + 1) * sidevertices + newvtx.first + 1;
+                }
+            }
+        }
+    }
+    return tables;
+}
+
+static const auto s_symmetry_tables = make_symmetry_tables();
+
+int FullBoard::get_symmetry_vertex(int size, int symmetry, int vertex) {
+    return s_symmetry_tables[size][symmetry][vertex];
+}
+
+void FullBoard::update_symmetry_ko_hashes(int vertex, int color) {
+    const auto& tables = s_symmetry_tables[m_boardsize];
+    for (auto s = 0; s < NUM_SYMMETRIES; s++) {
+        const auto newvtx = tables[s][vertex];
+        m_symmetry_ko_hash[s] ^= Zobrist::zobrist[EMPTY][newvtx];
+        m_symmetry_ko_hash[s] ^= Zobrist::zobrist[color][newvtx];
+    }
+}
+
 int FullBoard::remove_string(int i) {
     int pos = i;
     int removed = 0;
     int color = m_state[i];
 
     do {
-        m_hash    ^= Zobrist::zobrist[m_state[pos]][pos];
-        m_ko_hash ^= Zobrist::zobrist[m_state[pos]][pos];
+        const auto toggle = Zobrist::zobrist[color][pos]
+                          ^ Zobrist::zobrist[EMPTY][pos];
+        m_hash    ^= toggle;
+        m_ko_hash ^= toggle;
+        update_symmetry_ko_hashes(pos, color);
 
         m_state[pos] = EMPTY;
         m_parent[pos] = NUM_VERTICES;
@@ -56,9 +104,7 @@ int FullBoard::remove_string(int i) {
         m_empty_idx[pos]      = m_empty_cnt;
         m_empty[m_empty_cnt]  = pos;
         m_empty_cnt++;
-
-        m_hash    ^= Zobrist::zobrist[m_state[pos]][pos];
-        m_ko_hash ^= Zobrist::zobrist[m_state[pos]][pos];
+        m_empty_mask.set(get_index(pos));
 
         removed++;
         pos = m_next[pos];
@@ -118,6 +164,36 @@ std::uint64_t FullBoard::calc_symmetry_hash(int komove, int symmetry) const {
     });
 }
 
+std::uint64_t FullBoard::calc_symmetry_ko_hash(int symmetry) const {
+    const auto& table = s_symmetry_tables[m_boardsize][symmetry];
+    auto res = Zobrist::zobrist_empty;
+
+    for (auto i = 0; i < m_numvertices; i++) {
+        if (m_state[i] != INVAL) {
+            res ^= Zobrist::zobrist[m_state[i]][table[i]];
+        }
+    }
+
+    return res;
+}
+
+std::uint64_t FullBoard::get_symmetry_hash(int komove, int symmetry) const {
+    assert(symmetry >= 0 && symmetry < NUM_SYMMETRIES);
+    auto res = m_symmetry_ko_hash[symmetry];
+
+    /* prisoner hashing is rule set dependent */
+    res ^= Zobrist::zobrist_pris[0][m_prisoners[0]];
+    res ^= Zobrist::zobrist_pris[1][m_prisoners[1]];
+
+    if (m_tomove == BLACK) {
+        res ^= Zobrist::zobrist_blacktomove;
+    }
+
+    res ^= Zobrist::zobrist_ko[s_symmetry_tables[m_boardsize][symmetry][komove]];
+
+    return res;
+}
+
 std::uint64_t FullBoard::get_hash() const {
     return m_hash;
 }
@@ -148,6 +224,7 @@ int FullBoard::update_board(const int color, const int i) {
 
     m_hash ^= Zobrist::zobrist[m_state[i]][i];
     m_ko_hash ^= Zobrist::zobrist[m_state[i]][i];
+    update_symmetry_ko_hashes(i, color);
 
     /* update neighbor liberties (they all lose 1) */
     add_neighbour(i, color);
@@ -189,6 +266,7 @@ int FullBoard::update_board(const int color, const int i) {
     auto lastvertex = m_empty[--m_empty_cnt];
     m_empty_idx[lastvertex] = m_empty_idx[i];
     m_empty[m_empty_idx[i]] = lastvertex;
+    m_empty_mask.reset(get_index(i));
 
     /* check whether we still live (i.e. detect suicide) */
     if (m_libs[m_parent[i]] == 0) {
@@ -218,4 +296,7 @@ void FullBoard::reset_board(int size) {
 
     m_hash = calc_hash();
     m_ko_hash = calc_ko_hash();
+    for (auto s = 0; s < NUM_SYMMETRIES; s++) {
+        m_symmetry_ko_hash[s] = calc_symmetry_ko_hash(s);
+    }
 }
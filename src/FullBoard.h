@@ -31,11 +31,14 @@
 #define FULLBOARD_H_INCLUDED
 
 #include "config.h"
+#include <array>
 #include <cstdint>
 #include "FastBoard.h"
 
 class FullBoard : public FastBoard {
 public:
+    static constexpr auto NUM_SYMMETRIES = 8;
+
     int remove_string(int i);
     int update_board(const int color, const int i);
 
@@ -49,6 +52,11 @@ public:
     std::uint64_t calc_hash(int komove = NO_VERTEX) const;
     std::uint64_t calc_symmetry_hash(int komove, int symmetry) const;
     std::uint64_t calc_ko_hash() const;
+    // Same as calc_symmetry_hash, without going over the board.
+    std::uint64_t get_symmetry_hash(int komove, int symmetry) const;
+
+    // The vertex that vertex maps to under symmetry on a board of size.
+    static int get_symmetry_vertex(int size, int symmetry, int vertex);
 
     std::uint64_t m_hash;
     std::uint64_t m_ko_hash;
@@ -56,6 +64,19 @@ public:
 private:
     template<class Function>
     std::uint64_t calc_hash(int komove, Function transform) const;
+    std::uint64_t calc_symmetry_ko_hash(int symmetry) const;
+    void update_symmetry_ko_hashes(int vertex, int color);
+
+    // The ko hash of the board as seen through each symmetry, kept up
+    // to date as stones are played and removed.
+    std::array<std::uint64_t, NUM_SYMMETRIES> m_symmetry_ko_hash;
 };
 
+#ifdef USE_COMPACT_BOARD
+#include "CompactBoard.h"
+using GameBoard = CompactBoard;
+#else
+using GameBoard = FullBoard;
+#endif
+
 #endif
@@ -48,8 +48,10 @@
 #include "FullBoard.h"
 #include "GameState.h"
 #include "Network.h"
+#include "Profiler.h"
 #include "SGFTree.h"
 #include "SMP.h"
+#include "Trace.h"
 #include "Training.h"
 #include "UCTSearch.h"
 #include "Utils.h"
@@ -60,6 +62,8 @@ using namespace Utils;
 bool cfg_gtp_mode;
 bool cfg_allow_pondering;
 unsigned int cfg_num_threads;
+bool cfg_numa;
+int cfg_lockstep;
 unsigned int cfg_batch_size;
 int cfg_max_playouts;
 int cfg_max_visits;
@@ -73,8 +77,13 @@ int cfg_noise;
 int cfg_random_cnt;
 int cfg_random_min_visits;
 float cfg_random_temp;
+int cfg_fast_visits;
+float cfg_fast_prob;
+float cfg_kldgain;
+int cfg_kldgain_min_visits;
 std::uint64_t cfg_rng_seed;
 bool cfg_dumbpass;
+bool cfg_read_ladders;
 #ifdef USE_OPENCL
 std::vector<int> cfg_gpus;
 bool cfg_sgemm_exhaustive;
@@ -97,6 +106,7 @@ FILE* cfg_logfile_handle;
 bool cfg_quiet;
 std::string cfg_options_str;
 bool cfg_benchmark;
+std::vector<std::string> cfg_analyze_sgf;
 bool cfg_cpu_only;
 AnalyzeTags cfg_analyze_tags;
 
@@ -118,6 +128,7 @@ AnalyzeTags::AnalyzeTags(std::istringstream& cmdstream, const GameState& game) {
             cmdstream >> tag;
             if (cmdstream.fail() && cmdstream.eof()) {
                 /* Parsing complete */
+                compile_move_masks(game.board);
                 m_invalid = false;
                 return;
             }
@@ -251,6 +262,53 @@ void AnalyzeTags::add_move_to_allow(int color, int vertex, size_t until_move) {
     m_moves_to_allow.emplace_back(color, until_move, vertex);
 }
 
+void AnalyzeTags::compile_move_masks(const GameBoard& board) {
+    // The restrictions only change when a move number passes the
+    // until_move of some entry, so one mask per until_move covers
+    // all of them.
+    for (auto color : {FastBoard::BLACK, FastBoard::WHITE}) {
+        auto until_moves = std::vector<size_t>{};
+        for (const auto& move : m_moves_to_avoid) {
+            if (move.color == color) {
+                until_moves.emplace_back(move.until_move);
+            }
+        }
+        for (const auto& move : m_moves_to_allow) {
+            if (move.color == color) {
+                until_moves.emplace_back(move.until_move);
+            }
+        }
+        std::sort(begin(until_moves), end(until_moves));
+        until_moves.erase(std::unique(begin(until_moves), end(until_moves)),
+                          end(until_moves));
+
+        auto& masks = m_allowed_masks[color];
+        masks.clear();
+        for (const auto until_move : until_moves) {
+            auto mask = FastBoard::BoardMask{};
+            for (auto y = 0; y < BOARD_SIZE; y++) {
+                for (auto x = 0; x < BOARD_SIZE; x++) {
+                    const auto vertex = board.get_vertex(x, y);
+                    mask[board.get_index(vertex)] =
+                        !is_to_avoid(color, vertex, until_move);
+                }
+            }
+            masks.emplace_back(until_move, mask);
+        }
+    }
+}
+
+const FastBoard::BoardMask& AnalyzeTags::get_allowed_mask(int color,
+                                                          size_t movenum) const {
+    static const auto s_all = FastBoard::BoardMask{}.set();
+    for (const auto& entry : m_allowed_masks[color]) {
+        if (movenum <= entry.first) {
+            return entry.second;
+        }
+    }
+    return s_all;
+}
+
 int AnalyzeTags::interval_centis() const {
     return m_interval_centis;
 }
@@ -321,6 +379,8 @@ void GTP::setup_default_parameters() {
     cfg_num_threads = 1;
     // we will re-calculate this on Leela.cpp
     cfg_batch_size = 1;
+    cfg_numa = false;
+    cfg_lockstep = 0;
 
     cfg_max_memory = UCTSearch::DEFAULT_MAX_MEMORY;
     cfg_max_playouts = UCTSearch::UNLIMITED_PLAYOUTS;
@@ -354,10 +414,16 @@ void GTP::setup_default_parameters() {
     cfg_random_cnt = 0;
     cfg_random_min_visits = 1;
     cfg_random_temp = 1.0f;
+    cfg_fast_visits = 0;
+    cfg_fast_prob = 0.75f;
+    cfg_kldgain = 0.0f;
+    cfg_kldgain_min_visits = 100;
     cfg_dumbpass = false;
+    cfg_read_ladders = true;
     cfg_logfile_handle = nullptr;
     cfg_quiet = false;
     cfg_benchmark = false;
+    cfg_analyze_sgf.clear();
 #ifdef USE_CPU_ONLY
     cfg_cpu_only = true;
 #else
@@ -411,6 +477,10 @@ const std::string GTP::s_commands[] = {
     "lz-genmove_analyze",
     "lz-memory_report",
     "lz-setoption",
+    "lz-save_tree",
+    "lz-load_tree",
+    "lz-profile",
+    "lz-trace",
     "gomill-explain_last_move",
     ""
 };
@@ -465,7 +535,10 @@ void GTP::execute(GameState & game, const std::string& xinput) {
     bool transform_lowercase = true;
 
     // Required on Unixy systems
-    if (xinput.find("loadsgf") != std::string::npos) {
+    if (xinput.find("loadsgf") != std::string::npos
+        || xinput.find("lz-save_tree") != std::string::npos
+        || xinput.find("lz-load_tree") != std::string::npos
+        || xinput.find("lz-trace") != std::string::npos) {
         transform_lowercase = false;
     }
 
@@ -672,7 +745,7 @@ void GTP::execute(GameState & game, const std::string& xinput) {
             // now start pondering
             if (!game.has_resigned()) {
                 // Outputs winrate and pvs through gtp for lz-genmove_analyze
-                search->ponder();
+                search->ponder(!analysis_output);
             }
         }
         if (analysis_output) {
@@ -734,7 +807,7 @@ void GTP::execute(GameState & game, const std::string& xinput) {
             if (cfg_allow_pondering) {
                 // now start pondering
                 if (!game.has_resigned()) {
-                    search->ponder();
+                    search->ponder(true);
                 }
             }
         } else {
@@ -815,9 +888,10 @@ void GTP::execute(GameState & game, const std::string& xinput) {
 
             if (cfg_allow_pondering) {
                 // KGS sends this after our move
-                // now start pondering
+                // now start pondering, on the replies only if it is
+                // the opponent's turn
                 if (!game.has_resigned()) {
-                    search->ponder();
+                    search->ponder(game.get_to_move() != icolor);
                 }
             }
         } else {
@@ -906,11 +980,9 @@ void GTP::execute(GameState & game, const std::string& xinput) {
             gtp_printf_raw("= ");
         }
         auto game_history = game.get_game_history();
-        // undone moves may still be present, so reverse the portion of the
-        // array we need and resize to trim it down for iteration.
-        std::reverse(begin(game_history),
-                     begin(game_history) + game.get_movenum() + 1);
-        game_history.resize(game.get_movenum());
+        // Most recent move first. The starting position has no move.
+        std::reverse(begin(game_history), end(game_history));
+        game_history.pop_back();
         for (const auto &state : game_history) {
             auto coordinate = game.move_to_text(state->get_last_move());
             auto color = state->get_to_move() == FastBoard::WHITE ? "black" : "white";
@@ -1178,8 +1250,77 @@ void GTP::execute(GameState & game, const std::string& xinput) {
             "Network with overhead: %d MiB / Search tree: %d MiB / Network cache: %d\n",
             total / MiB, base_memory / MiB, tree_size / MiB, cache_size / MiB);
         return;
+    } else if (command.find("lz-profile") == 0) {
+#ifdef USE_PROFILER
+        std::istringstream cmdstream(command);
+        std::string tmp;
+
+        cmdstream >> tmp; // eat lz-profile
+        cmdstream >> tmp;
+        if (!cmdstream.fail()) {
+            if (tmp != "reset") {
+                gtp_fail_printf(id, "syntax not understood");
+                return;
+            }
+            Profiler::reset();
+            gtp_printf(id, "");
+        } else {
+            auto report = Profiler::get_report();
+            // Drop the final newline, gtp_printf ends the response.
+            report.pop_back();
+            gtp_printf(id, "\n%s", report.c_str());
+        }
+#else
+        gtp_fail_printf(id, "not compiled with USE_PROFILER");
+#endif
+        return;
+    } else if (command.find("lz-trace") == 0) {
+        std::istringstream cmdstream(command);
+        std::string tmp, filename;
+
+        cmdstream >> tmp; // eat lz-trace
+        cmdstream >> tmp;
+        if (!cmdstream.fail() && tmp == "start") {
+            Trace::start();
+            gtp_printf(id, "");
+        } else if (!cmdstream.fail() && tmp == "stop") {
+            cmdstream >> filename;
+            if (cmdstream.fail()) {
+                gtp_fail_printf(id, "missing filename");
+            } else if (Trace::stop(filename)) {
+                gtp_printf(id, "");
+            } else {
+                gtp_fail_printf(id, "cannot write %s", filename.c_str());
+            }
+        } else {
+            gtp_fail_printf(id, "syntax not understood");
+        }
+        return;
     } else if (command.find("lz-setoption") == 0) {
         return execute_setoption(*search.get(), id, command);
+    } else if (command.find("lz-save_tree") == 0
+               || command.find("lz-load_tree") == 0) {
+        std::istringstream cmdstream(command);
+        std::string tmp, filename;
+
+        // tmp will eat the command name
+        cmdstream >> tmp >> filename;
+
+        if (cmdstream.fail()) {
+            gtp_fail_printf(id, "syntax not understood");
+            return;
+        }
+
+        auto success = (tmp == "lz-save_tree")
+            ? search->save_tree(filename)
+            : search->load_tree(filename);
+        if (success) {
+            gtp_printf(id, "");
+        } else {
+            gtp_fail_printf(id, "cannot %s search tree",
+                            tmp == "lz-save_tree" ? "save" : "load");
+        }
+        return;
     } else if (command.find("gomill-explain_last_move") == 0) {
         gtp_printf(id, "%s\n", search->explain_last_think().c_str());
         return;
@@ -32,8 +32,10 @@
 
 #include "config.h"
 
+#include <array>
 #include <cstdio>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "Network.h"
@@ -64,16 +66,25 @@ public:
 
     void add_move_to_avoid(int color, int vertex, size_t until_move);
     void add_move_to_allow(int color, int vertex, size_t until_move);
+    // Build the allowed masks once all the moves have been added.
+    void compile_move_masks(const GameBoard& board);
     int interval_centis() const;
     int invalid() const;
     int who() const;
     size_t post_move_count() const;
     bool is_to_avoid(int color, int vertex, size_t movenum) const;
     bool has_move_restrictions() const;
+    // Intersections not avoided by color at movenum.
+    const FastBoard::BoardMask& get_allowed_mask(int color,
+                                                 size_t movenum) const;
 
 private:
     bool m_invalid{true};
     std::vector<MoveToAvoid> m_moves_to_avoid, m_moves_to_allow;
+    // Per color, the allowed intersections up to each until_move in
+    // the avoid and allow lists, in increasing order.
+    std::array<std::vector<std::pair<size_t, FastBoard::BoardMask>>, 2>
+        m_allowed_masks;
     int m_interval_centis{0};
     int m_who{FastBoard::INVAL};
     size_t m_min_moves{0};
@@ -82,6 +93,8 @@ private:
 extern bool cfg_gtp_mode;
 extern bool cfg_allow_pondering;
 extern unsigned int cfg_num_threads;
+extern bool cfg_numa;
+extern int cfg_lockstep;
 extern unsigned int cfg_batch_size;
 extern int cfg_max_playouts;
 extern int cfg_max_visits;
@@ -95,8 +108,13 @@ extern int cfg_noise;
 extern int cfg_random_cnt;
 extern int cfg_random_min_visits;
 extern float cfg_random_temp;
+extern int cfg_fast_visits;
+extern float cfg_fast_prob;
+extern float cfg_kldgain;
+extern int cfg_kldgain_min_visits;
 extern std::uint64_t cfg_rng_seed;
 extern bool cfg_dumbpass;
+extern bool cfg_read_ladders;
 #ifdef USE_OPENCL
 extern std::vector<int> cfg_gpus;
 extern bool cfg_sgemm_exhaustive;
@@ -122,6 +140,7 @@ extern FILE* cfg_logfile_handle;
 extern bool cfg_quiet;
 extern std::string cfg_options_str;
 extern bool cfg_benchmark;
+extern std::vector<std::string> cfg_analyze_sgf;
 extern bool cfg_cpu_only;
 extern AnalyzeTags cfg_analyze_tags;
 
@@ -46,8 +46,7 @@
 void GameState::init_game(int size, float komi) {
     KoState::init_game(size, komi);
 
-    game_history.clear();
-    game_history.emplace_back(std::make_shared<KoState>(*this));
+    start_game_history();
 
     m_timecontrol.reset_clocks();
 
@@ -57,32 +56,49 @@ void GameState::init_game(int size, float komi) {
 void GameState::reset_game() {
     KoState::reset_game();
 
-    game_history.clear();
-    game_history.emplace_back(std::make_shared<KoState>(*this));
+    start_game_history();
 
     m_timecontrol.reset_clocks();
 
     m_resigned = FastBoard::EMPTY;
 }
 
+void GameState::start_game_history() {
+    m_history = std::make_shared<const HistoryEntry>(
+        HistoryEntry{std::make_shared<const KoState>(*this), nullptr});
+    m_history_end = m_history;
+}
+
+void GameState::push_game_history() {
+    // This cuts off any leftover moves from navigating.
+    m_history = std::make_shared<const HistoryEntry>(
+        HistoryEntry{std::make_shared<const KoState>(*this), m_history});
+    m_history_end = m_history;
+}
+
 bool GameState::forward_move() {
-    if (game_history.size() > m_movenum + 1) {
-        m_movenum++;
-        *(static_cast<KoState*>(this)) = *game_history[m_movenum];
-        return true;
-    } else {
+    if (m_history == m_history_end) {
         return false;
     }
+    // The list only links backwards, so look for the next
+    // position from the end of the line.
+    auto next = m_history_end;
+    while (next->previous != m_history) {
+        next = next->previous;
+    }
+    m_history = next;
+
+    // This also restores hashes as they're part of state
+    *(static_cast<KoState*>(this)) = *m_history->state;
+    return true;
 }
 
 bool GameState::undo_move() {
-    if (m_movenum > 0) {
-        m_movenum--;
-
-        // this is not so nice, but it should work
-        *(static_cast<KoState*>(this)) = *game_history[m_movenum];
+    if (m_history->previous) {
+        m_history = m_history->previous;
 
         // This also restores hashes as they're part of state
+        *(static_cast<KoState*>(this)) = *m_history->state;
         return true;
     } else {
         return false;
@@ -90,8 +106,10 @@ bool GameState::undo_move() {
 }
 
 void GameState::rewind() {
-    *(static_cast<KoState*>(this)) = *game_history[0];
-    m_movenum = 0;
+    while (m_history->previous) {
+        m_history = m_history->previous;
+    }
+    *(static_cast<KoState*>(this)) = *m_history->state;
 }
 
 void GameState::play_move(int vertex) {
@@ -105,9 +123,7 @@ void GameState::play_move(int color, int vertex) {
         KoState::play_move(color, vertex);
     }
 
-    // cut off any leftover moves from navigating
-    game_history.resize(m_movenum);
-    game_history.emplace_back(std::make_shared<KoState>(*this));
+    push_game_history();
 }
 
 bool GameState::play_textmove(std::string color, const std::string& vertex) {
@@ -178,8 +194,7 @@ void GameState::adjust_time(int color, int time, int stones) {
 void GameState::anchor_game_history() {
     // handicap moves don't count in game history
     m_movenum = 0;
-    game_history.clear();
-    game_history.emplace_back(std::make_shared<KoState>(*this));
+    start_game_history();
 }
 
 bool GameState::set_fixed_handicap(int handicap) {
@@ -311,12 +326,20 @@ void GameState::place_free_handicap(int stones, Network & network) {
     set_handicap(orgstones);
 }
 
-const FullBoard& GameState::get_past_board(int moves_ago) const {
+const GameBoard& GameState::get_past_board(int moves_ago) const {
     assert(moves_ago >= 0 && (unsigned)moves_ago <= m_movenum);
-    assert(m_movenum + 1 <= game_history.size());
-    return game_history[m_movenum - moves_ago]->board;
+    auto entry = m_history.get();
+    for (auto i = 0; i < moves_ago; i++) {
+        entry = entry->previous.get();
+    }
+    return entry->state->board;
 }
 
-const std::vector<std::shared_ptr<const KoState>>& GameState::get_game_history() const {
-    return game_history;
+std::vector<std::shared_ptr<const KoState>> GameState::get_game_history() const {
+    auto history = std::vector<std::shared_ptr<const KoState>>{};
+    for (auto entry = m_history.get(); entry; entry = entry->previous.get()) {
+        history.emplace_back(entry->state);
+    }
+    std::reverse(begin(history), end(history));
+    return history;
 }
@@ -59,8 +59,9 @@ public:
     void rewind(); /* undo infinite */
     bool undo_move();
     bool forward_move();
-    const FullBoard& get_past_board(int moves_ago) const;
-    const std::vector<std::shared_ptr<const KoState>>& get_game_history() const;
+    const GameBoard& get_past_board(int moves_ago) const;
+    // The positions from the start of the game up to the current one.
+    std::vector<std::shared_ptr<const KoState>> get_game_history() const;
 
     void play_move(int color, int vertex);
     void play_move(int vertex);
@@ -81,7 +82,21 @@ public:
 private:
     bool valid_handicap(int stones);
 
-    std::vector<std::shared_ptr<const KoState>> game_history;
+    // One position of the game, linked to the one before it. Entries
+    // are never changed once made, so copies of a game state share
+    // the history they have in common and copying one is cheap.
+    struct HistoryEntry {
+        std::shared_ptr<const KoState> state;
+        std::shared_ptr<const HistoryEntry> previous;
+    };
+
+    void start_game_history();
+    void push_game_history();
+
+    // The entry of the current position, and that of the last move
+    // played, which is further along when moves have been undone.
+    std::shared_ptr<const HistoryEntry> m_history;
+    std::shared_ptr<const HistoryEntry> m_history_end;
     TimeControl m_timecontrol;
     int m_resigned{FastBoard::EMPTY};
 };
@@ -38,29 +38,100 @@
 #include "FastState.h"
 #include "FullBoard.h"
 
+KoHashSet::KoHashSet(const KoHashSet& other, size_t extra) {
+    // Keep the load factor at or below one half.
+    auto capacity = size_t{64};
+    while (capacity < 2 * (other.m_count + extra)) {
+        capacity *= 2;
+    }
+    m_slots.resize(capacity, 0);
+    m_has_zero = other.m_has_zero;
+    for (const auto hash : other.m_slots) {
+        if (hash != 0) {
+            insert(hash);
+        }
+    }
+}
+
+void KoHashSet::insert(std::uint64_t hash) {
+    if (hash == 0) {
+        m_has_zero = true;
+        return;
+    }
+    assert(2 * (m_count + 1) <= m_slots.size());
+    // Zobrist hashes are random already, so the low bits will do.
+    const auto mask = m_slots.size() - 1;
+    for (auto slot = hash & mask; ; slot = (slot + 1) & mask) {
+        if (m_slots[slot] == hash) {
+            return;
+        } else if (m_slots[slot] == 0) {
+            m_slots[slot] = hash;
+            m_count++;
+            return;
+        }
+    }
+}
+
+bool KoHashSet::contains(std::uint64_t hash) const {
+    if (hash == 0) {
+        return m_has_zero;
+    }
+    if (m_slots.empty()) {
+        return false;
+    }
+    const auto mask = m_slots.size() - 1;
+    for (auto slot = hash & mask; m_slots[slot] != 0; slot = (slot + 1) & mask) {
+        if (m_slots[slot] == hash) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void KoState::init_game(int size, float komi) {
     assert(size <= BOARD_SIZE);
 
     FastState::init_game(size, komi);
 
-    m_ko_hash_history.clear();
-    m_ko_hash_history.emplace_back(board.get_ko_hash());
+    m_ko_hashes.reset();
+    m_recent_count = 0;
 }
 
 bool KoState::superko() const {
-    auto first = crbegin(m_ko_hash_history);
-    auto last = crend(m_ko_hash_history);
-
-    auto res = std::find(++first, last, board.get_ko_hash());
-
-    return (res != last);
+    const auto hash = board.get_ko_hash();
+    const auto recent_end = begin(m_recent_ko_hashes) + m_recent_count;
+    if (std::find(begin(m_recent_ko_hashes), recent_end, hash) != recent_end) {
+        return true;
+    }
+    return m_ko_hashes && m_ko_hashes->contains(hash);
 }
 
 void KoState::reset_game() {
     FastState::reset_game();
 
-    m_ko_hash_history.clear();
-    m_ko_hash_history.push_back(board.get_ko_hash());
+    m_ko_hashes.reset();
+    m_recent_count = 0;
+}
+
+void KoState::fold_ko_hashes() {
+    if (m_recent_count == 0) {
+        return;
+    }
+    auto ko_hashes = m_ko_hashes
+        ? std::make_shared<KoHashSet>(*m_ko_hashes, m_recent_count)
+        : std::make_shared<KoHashSet>(KoHashSet{}, m_recent_count);
+    for (auto i = size_t{0}; i < m_recent_count; i++) {
+        ko_hashes->insert(m_recent_ko_hashes[i]);
+    }
+    m_ko_hashes = std::move(ko_hashes);
+    m_recent_count = 0;
+}
+
+void KoState::add_ko_hash(std::uint64_t hash) {
+    if (m_recent_count == MAX_RECENT_KO_HASHES) {
+        fold_ko_hashes();
+    }
+    m_recent_ko_hashes[m_recent_count++] = hash;
 }
 
 void KoState::play_move(int vertex) {
@@ -68,8 +139,9 @@ void KoState::play_move(int vertex) {
 }
 
 void KoState::play_move(int color, int vertex) {
+    // Remember the position we are leaving.
+    add_ko_hash(board.get_ko_hash());
     if (vertex != FastBoard::RESIGN) {
         FastState::play_move(color, vertex);
     }
-    m_ko_hash_history.push_back(board.get_ko_hash());
 }
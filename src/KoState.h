@@ -32,11 +32,31 @@
 
 #include "config.h"
 
+#include <array>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 #include "FastState.h"
 #include "FullBoard.h"
 
+// Open-addressed set of ko hashes.
+class KoHashSet {
+public:
+    KoHashSet() = default;
+    // A copy of other with room for extra more hashes.
+    KoHashSet(const KoHashSet& other, size_t extra);
+
+    void insert(std::uint64_t hash);
+    bool contains(std::uint64_t hash) const;
+
+private:
+    // Zero marks an empty slot, so it is kept aside.
+    std::vector<std::uint64_t> m_slots;
+    size_t m_count{0};
+    bool m_has_zero{false};
+};
+
 class KoState : public FastState {
 public:
     void init_game(int size, float komi);
@@ -46,8 +66,22 @@ public:
     void play_move(int color, int vertex);
     void play_move(int vertex);
 
+    // Move the recent ko hashes into a new shared set, so that copies
+    // of this state start with an empty list of their own.
+    void fold_ko_hashes();
+
 private:
-    std::vector<std::uint64_t> m_ko_hash_history;
+    static constexpr size_t MAX_RECENT_KO_HASHES = 32;
+
+    void add_ko_hash(std::uint64_t hash);
+
+    // Ko hashes of the earlier positions of the game. Most of them are
+    // in a set shared with the states we were copied from, which is
+    // never changed once built. The latest ones are kept in a short
+    // list of our own until it fills up and they are moved to a new set.
+    std::shared_ptr<const KoHashSet> m_ko_hashes;
+    std::array<std::uint64_t, MAX_RECENT_KO_HASHES> m_recent_ko_hashes{};
+    size_t m_recent_count{0};
 };
 
 #endif
@@ -0,0 +1,182 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#include "config.h"
+#include "Ladder.h"
+
+#include <array>
+#include <cassert>
+
+#include "FastBoard.h"
+
+bool Ladder::has_atari(const GameBoard& board, int color) {
+    const auto size = board.get_boardsize();
+    for (auto y = 0; y < size; y++) {
+        for (auto x = 0; x < size; x++) {
+            const auto vertex = board.get_vertex(x, y);
+            if (board.get_state(vertex) == color
+                && board.count_liberties(vertex) == 1) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool Ladder::is_ladder_escape(const FastState& state, int vertex) {
+    const auto& board = state.board;
+    const auto color = board.get_to_move();
+    if (vertex == FastBoard::PASS || vertex == FastBoard::RESIGN
+        || board.get_state(vertex) != FastBoard::EMPTY) {
+        return false;
+    }
+
+    // Only a move on the last liberty of a string of ours can be one.
+    auto extends_atari = false;
+    const auto xy = board.get_xy(vertex);
+    const auto size = board.get_boardsize();
+    const auto neighbours = std::array<std::pair<int, int>, 4>{{
+        {xy.first - 1, xy.second}, {xy.first + 1, xy.second},
+        {xy.first, xy.second - 1}, {xy.first, xy.second + 1}}};
+    for (const auto& nb : neighbours) {
+        if (nb.first < 0 || nb.first >= size
+            || nb.second < 0 || nb.second >= size) {
+            continue;
+        }
+        const auto ai = board.get_vertex(nb.first, nb.second);
+        if (board.get_state(ai) == color && board.count_liberties(ai) == 1) {
+            extends_atari = true;
+            break;
+        }
+    }
+    if (!extends_atari || board.is_suicide(vertex, color)) {
+        return false;
+    }
+
+    auto next = board;
+    next.update_board(color, vertex);
+    if (next.count_liberties(vertex) != 2) {
+        return false;
+    }
+    auto nodes = MAX_NODES;
+    return capture(next, vertex, !color, nodes);
+}
+
+bool Ladder::is_ladder_capture(const GameBoard& board, int vertex,
+                               int attacker) {
+    assert(board.get_state(vertex) == !attacker);
+    assert(board.count_liberties(vertex) == 2);
+    auto next = board;
+    auto nodes = MAX_NODES;
+    return capture(next, vertex, attacker, nodes);
+}
+
+// The vertices of the first points in mask.
+template <size_t N>
+static std::array<int, N> get_vertices(const GameBoard& board,
+                                       const FastBoard::BoardMask& mask) {
+    auto vertices = std::array<int, N>{};
+    auto found = size_t{0};
+    for (auto i = 0; i < NUM_INTERSECTIONS && found < N; i++) {
+        if (mask[i]) {
+            vertices[found++] =
+                board.get_vertex(i % BOARD_SIZE, i / BOARD_SIZE);
+        }
+    }
+    assert(found == N);
+    return vertices;
+}
+
+bool Ladder::capture(GameBoard& board, int vertex, int attacker,
+                     int& nodes) {
+    if (--nodes < 0) {
+        return false;
+    }
+
+    // Try an atari from either side, the second one on board itself.
+    const auto liberties =
+        get_vertices<2>(board, board.get_string_liberties(vertex));
+    if (!board.is_suicide(liberties[0], attacker)) {
+        auto next = board;
+        if (chase(next, vertex, liberties[0], attacker, nodes)) {
+            return true;
+        }
+    }
+    return !board.is_suicide(liberties[1], attacker)
+           && chase(board, vertex, liberties[1], attacker, nodes);
+}
+
+bool Ladder::chase(GameBoard& board, int vertex, int atari, int attacker,
+                   int& nodes) {
+    board.update_board(attacker, atari);
+    // An atari that can be captured right away does not chase.
+    if (board.count_liberties(atari) < 2
+        || board.count_liberties(vertex) != 1) {
+        return false;
+    }
+    return escape_fails(board, vertex, !attacker, nodes);
+}
+
+bool Ladder::escape_fails(GameBoard& board, int vertex, int defender,
+                          int& nodes) {
+    if (--nodes < 0) {
+        return false;
+    }
+
+    // Capturing a chasing string in atari gets out of the ladder.
+    const auto size = board.get_boardsize();
+    const auto stones = board.get_string_stones(vertex);
+    const auto around = FastBoard::get_neighbours(stones)
+                        & ~stones & ~board.get_empty_mask();
+    for (auto i = 0; i < NUM_INTERSECTIONS; i++) {
+        const auto x = i % BOARD_SIZE;
+        const auto y = i / BOARD_SIZE;
+        if (!around[i] || x >= size || y >= size) {
+            continue;
+        }
+        const auto ai = board.get_vertex(x, y);
+        if (board.get_state(ai) == !defender && board.count_liberties(ai) == 1) {
+            return false;
+        }
+    }
+
+    const auto liberty =
+        get_vertices<1>(board, board.get_string_liberties(vertex))[0];
+    if (board.is_suicide(liberty, defender)) {
+        return true;
+    }
+    board.update_board(defender, liberty);
+    const auto liberties = board.count_liberties(vertex);
+    if (liberties >= 3) {
+        return false;
+    } else if (liberties <= 1) {
+        return true;
+    }
+    return capture(board, vertex, !defender, nodes);
+}
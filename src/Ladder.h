@@ -0,0 +1,76 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#ifndef LADDER_H_INCLUDED
+#define LADDER_H_INCLUDED
+
+#include "config.h"
+
+#include "FastState.h"
+#include "FullBoard.h"
+
+/*
+    Reads ladders on the board: a string with two liberties that the
+    opponent keeps in atari move after move until it is captured. The
+    network sees long ladders poorly, so the search uses this to avoid
+    spending playouts on escapes that cannot work.
+*/
+class Ladder {
+public:
+    // Positions visited by one reading at most. Longer readings are
+    // given up on, and the escape assumed to work.
+    static constexpr auto MAX_NODES = 256;
+
+    // Whether color has a string in atari. Without one, no move of
+    // theirs can be a ladder escape.
+    static bool has_atari(const GameBoard& board, int color);
+
+    // Whether vertex, played by the side to move, extends a string of
+    // theirs out of atari into a ladder that still captures it.
+    static bool is_ladder_escape(const FastState& state, int vertex);
+
+    // Whether attacker, to move, captures the string at vertex, which
+    // has two liberties, by a ladder.
+    static bool is_ladder_capture(const GameBoard& board, int vertex,
+                                  int attacker);
+
+private:
+    // These play the reading on board, which is left changed, and copy
+    // it only where there are two moves to try.
+    static bool capture(GameBoard& board, int vertex, int attacker,
+                        int& nodes);
+    static bool chase(GameBoard& board, int vertex, int atari,
+                      int attacker, int& nodes);
+    static bool escape_fails(GameBoard& board, int vertex, int defender,
+                             int& nodes);
+
+    friend class LeelaTest;
+};
+
+#endif
@@ -36,16 +36,22 @@
 #include <boost/program_options.hpp>
 #include <cstdio>
 #include <cstdlib>
+#include <deque>
+#include <exception>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "AnalysisEngine.h"
 #include "GTP.h"
 #include "GameState.h"
 #include "Network.h"
 #include "NNCache.h"
 #include "Random.h"
+#include "SGFParser.h"
+#include "SGFTree.h"
 #include "ThreadPool.h"
 #include "Utils.h"
 #include "Zobrist.h"
@@ -152,15 +158,29 @@ static void parse_commandline(int argc, char *argv[]) {
         ("logfile,l", po::value<std::string>(), "File to log input/output to.")
         ("quiet,q", "Disable all diagnostic output.")
         ("timemanage", po::value<std::string>()->default_value("auto"),
-                       "[auto|on|off|fast|no_pruning] Enable time management features.\n"
+                       "[auto|on|off|fast|adaptive|no_pruning] Enable time management features.\n"
                        "auto = no_pruning when using -n, otherwise on.\n"
                        "on = Cut off search when the best move can't change"
                        ", but use full time if moving faster doesn't save time.\n"
                        "fast = Same as on but always plays faster.\n"
+                       "adaptive = Same as on but stops early once the best "
+                       "move is stable and thinks longer when it is not.\n"
                        "no_pruning = For self play training use.\n")
         ("noponder", "Disable thinking on opponent's time.")
+        ("noladders", "Don't read ladders to steer the search away from "
+                      "escapes that cannot work. Also off with -n.")
+        ("numa", "Search a separate tree on each NUMA node "
+                 "and combine them at the root.")
+        ("lockstep", po::value<int>(),
+                     "Search deterministically, with x virtual threads "
+                     "running in lock-step. The result does not depend "
+                     "on --threads. Requires --noponder.")
         ("benchmark", "Test network and exit. Default args:\n-v3200 --noponder "
                       "-m0 -t1 -s1.")
+        ("analyze-sgf", po::value<std::vector<std::string>>()->multitoken(),
+                        "Analyze every mainline position of the given SGF "
+                        "files or directories, print the results as JSON "
+                        "lines and exit. Defaults to -v800.")
 #ifndef USE_CPU_ONLY
         ("cpu-only", "Use CPU-only implementation and do not use OpenCL device(s).")
 #endif
@@ -194,6 +214,19 @@ static void parse_commandline(int argc, char *argv[]) {
         ("randomtemp",
             po::value<float>()->default_value(cfg_random_temp),
             "Temperature to use for random move selection.")
+        ("fastvisits",
+            po::value<int>()->default_value(cfg_fast_visits),
+            "Search some moves with at most x visits and leave them "
+            "out of the training data. 0 disables.")
+        ("fastprob", po::value<float>()->default_value(cfg_fast_prob),
+            "Fraction of moves searched with --fastvisits.")
+        ("kldgain", po::value<float>()->default_value(cfg_kldgain),
+            "Stop searching once the root visit distribution changes by "
+            "less than x (KL-divergence per visit) between samples.\n"
+            "0 disables.")
+        ("kldgainvisits",
+            po::value<int>()->default_value(cfg_kldgain_min_visits),
+            "Don't stop on --kldgain before x visits.")
         ;
 #ifdef USE_TUNER
     po::options_description tuner_desc("Tuning options");
@@ -264,7 +297,7 @@ static void parse_commandline(int argc, char *argv[]) {
         cfg_quiet = true;
     }
 
-    if (vm.count("benchmark")) {
+    if (vm.count("benchmark") || vm.count("analyze-sgf")) {
         cfg_quiet = true;  // Set this early to avoid unnecessary output.
     }
 
@@ -363,9 +396,19 @@ static void parse_commandline(int argc, char *argv[]) {
     }
     myprintf("Using %d thread(s).\n", cfg_num_threads);
 
+    if (vm.count("lockstep")) {
+        cfg_lockstep = vm["lockstep"].as<int>();
+        if (cfg_lockstep > 0 && !vm.count("noponder")) {
+            printf("Nonsensical options: Lock-step search is requested "
+                   "but thinking on the opponent's time is still allowed. "
+                   "Add --noponder for reproducible searches.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
     if (vm.count("seed")) {
         cfg_rng_seed = vm["seed"].as<std::uint64_t>();
-        if (cfg_num_threads > 1) {
+        if (cfg_num_threads > 1 && cfg_lockstep == 0) {
             myprintf("Seed specified but multiple threads enabled.\n");
             myprintf("Games will likely not be reproducible.\n");
         }
@@ -380,6 +423,15 @@ static void parse_commandline(int argc, char *argv[]) {
         cfg_noise = true;
     }
 
+    // Self-play games should only reflect what the network knows.
+    if (vm.count("noladders") || cfg_noise) {
+        cfg_read_ladders = false;
+    }
+
+    if (vm.count("numa")) {
+        cfg_numa = true;
+    }
+
     if (vm.count("dumbpass")) {
         cfg_dumbpass = true;
     }
@@ -420,6 +472,26 @@ static void parse_commandline(int argc, char *argv[]) {
         cfg_random_min_visits = vm["randomvisits"].as<int>();
     }
 
+    if (vm.count("fastvisits")) {
+        cfg_fast_visits = vm["fastvisits"].as<int>();
+    }
+
+    if (vm.count("fastprob")) {
+        cfg_fast_prob = vm["fastprob"].as<float>();
+        if (cfg_fast_prob < 0.0f || cfg_fast_prob > 1.0f) {
+            printf("Invalid fastprob value, must be between 0 and 1.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (vm.count("kldgain")) {
+        cfg_kldgain = vm["kldgain"].as<float>();
+    }
+
+    if (vm.count("kldgainvisits")) {
+        cfg_kldgain_min_visits = vm["kldgainvisits"].as<int>();
+    }
+
     if (vm.count("randomtemp")) {
         cfg_random_temp = vm["randomtemp"].as<float>();
     }
@@ -434,6 +506,8 @@ static void parse_commandline(int argc, char *argv[]) {
             cfg_timemanage = TimeManagement::OFF;
         } else if (tm == "fast") {
             cfg_timemanage = TimeManagement::FAST;
+        } else if (tm == "adaptive") {
+            cfg_timemanage = TimeManagement::ADAPTIVE;
         } else if (tm == "no_pruning") {
             cfg_timemanage = TimeManagement::NO_PRUNING;
         } else {
@@ -468,6 +542,15 @@ static void parse_commandline(int argc, char *argv[]) {
         }
     }
 
+    if (vm.count("analyze-sgf")) {
+        cfg_analyze_sgf = vm["analyze-sgf"].as<std::vector<std::string>>();
+        cfg_allow_pondering = false;
+
+        if (!vm.count("playouts") && !vm.count("visits")) {
+            cfg_max_visits = 800;
+        }
+    }
+
     // Do not lower the expected eval for root moves that are likely not
     // the best if we have introduced noise there exactly to explore more.
     cfg_fpu_root_reduction = cfg_noise ? 0.0f : cfg_fpu_reduction;
@@ -519,6 +602,150 @@ void benchmark(GameState& game) {
     search->think(FastBoard::WHITE);
 }
 
+static std::string json_quote(const std::string& s) {
+    auto out = std::string{"\""};
+    for (const auto c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out += str(boost::format("\\u%04x") % int(c));
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static std::vector<std::string> find_sgf_files(
+    const std::vector<std::string>& paths) {
+    namespace fs = boost::filesystem;
+    auto files = std::vector<std::string>{};
+    for (const auto& path : paths) {
+        if (!fs::is_directory(path)) {
+            files.emplace_back(path);
+            continue;
+        }
+        auto dir_files = std::vector<std::string>{};
+        for (const auto& entry : fs::recursive_directory_iterator(path)) {
+            if (fs::is_regular_file(entry.path())
+                && entry.path().extension() == ".sgf") {
+                dir_files.emplace_back(entry.path().string());
+            }
+        }
+        std::sort(begin(dir_files), end(dir_files));
+        files.insert(end(files), begin(dir_files), end(dir_files));
+    }
+    return files;
+}
+
+// Analyze every position of the mainline of every game, one search per
+// thread. Each game goes to a single search, so the tree is reused from
+// one move to the next, and as many games as there are searches are
+// in flight at once. Results are printed in game order.
+void analyze_sgf(const std::vector<std::string>& paths) {
+    struct Position {
+        std::string header;
+        std::future<AnalysisResult> result;
+    };
+
+    const auto visits = std::min(cfg_max_playouts, cfg_max_visits);
+    AnalysisEngine engine(*GTP::s_network, cfg_num_threads, 1);
+    auto pending = std::deque<std::deque<Position>>{};
+
+    auto print_game = [](std::deque<Position>& game) {
+        for (auto& position : game) {
+            const auto result = position.result.get();
+            auto line = position.header
+                + ",\"visits\":" + std::to_string(result.visits)
+                + ",\"moves\":[";
+            for (auto i = size_t{0}; i < result.moves.size(); i++) {
+                line += (i == 0 ? "" : ",") + result.moves[i].get_json_string();
+            }
+            line += "]}";
+            std::cout << line << std::endl;
+        }
+    };
+
+    auto gamecount = size_t{0};
+    for (const auto& file : find_sgf_files(paths)) {
+        auto games = std::vector<std::string>{};
+        try {
+            games = SGFParser::chop_all(file);
+        } catch (...) {
+            myprintf_error("Could not read %s.\n", file.c_str());
+            continue;
+        }
+        for (auto index = size_t{0}; index < games.size(); index++) {
+            auto sgftree = std::make_unique<SGFTree>();
+            try {
+                sgftree->load_from_string(games[index]);
+            } catch (const std::exception& e) {
+                // Games on other board sizes end up here too.
+                myprintf_error("Skipping game %zu of %s: %s\n",
+                               index, file.c_str(), e.what());
+                continue;
+            }
+            auto state = sgftree->follow_mainline_state(0);
+            // Our board size is hardcoded in several places
+            if (state.board.get_boardsize() != BOARD_SIZE) {
+                myprintf_error("Skipping game %zu of %s: it is %dx%d.\n",
+                               index, file.c_str(),
+                               state.board.get_boardsize(),
+                               state.board.get_boardsize());
+                continue;
+            }
+
+            // Take the colors from the game, as they need not alternate.
+            auto moves = std::vector<std::pair<int, int>>{};
+            for (auto link = sgftree->get_child(0); link != nullptr;
+                 link = link->get_child(0)) {
+                const auto move = link->get_colored_move();
+                if (move.first != FastBoard::INVAL) {
+                    moves.push_back(move);
+                }
+            }
+
+            auto game = std::deque<Position>{};
+            for (auto movenum = size_t{0}; ; movenum++) {
+                if (movenum < moves.size()) {
+                    state.set_to_move(moves[movenum].first);
+                }
+                const auto to_move = state.get_to_move();
+                auto header = "{\"file\":" + json_quote(file)
+                    + ",\"game\":" + std::to_string(index)
+                    + ",\"movenum\":" + std::to_string(movenum)
+                    + ",\"tomove\":\""
+                    + (to_move == FastBoard::BLACK ? "b" : "w") + "\"";
+                if (movenum < moves.size()) {
+                    header += ",\"played\":\""
+                        + state.move_to_text(moves[movenum].second) + "\"";
+                }
+                game.push_back({header,
+                                engine.submit(state, visits, gamecount)});
+
+                if (movenum >= moves.size()
+                    || (moves[movenum].second != FastBoard::PASS
+                        && state.board.get_state(moves[movenum].second)
+                           != FastBoard::EMPTY)) {
+                    break;
+                }
+                state.play_move(moves[movenum].first, moves[movenum].second);
+            }
+            pending.emplace_back(std::move(game));
+            gamecount++;
+
+            if (pending.size() >= engine.get_search_count()) {
+                print_game(pending.front());
+                pending.pop_front();
+            }
+        }
+    }
+    for (auto& game : pending) {
+        print_game(game);
+    }
+}
+
 int main(int argc, char *argv[]) {
     // Set up engine parameters
     GTP::setup_default_parameters();
@@ -535,7 +762,7 @@ int main(int argc, char *argv[]) {
     setbuf(stdin, nullptr);
 #endif
 
-    if (!cfg_gtp_mode && !cfg_benchmark) {
+    if (!cfg_gtp_mode && !cfg_benchmark && cfg_analyze_sgf.empty()) {
         license_blurb();
     }
 
@@ -552,6 +779,11 @@ int main(int argc, char *argv[]) {
         return 0;
     }
 
+    if (!cfg_analyze_sgf.empty()) {
+        analyze_sgf(cfg_analyze_sgf);
+        return 0;
+    }
+
     for (;;) {
         if (!cfg_gtp_mode) {
             maingame->display_state();
@@ -67,6 +67,8 @@
 #include "GameState.h"
 #include "GTP.h"
 #include "NNCache.h"
+#include "Profiler.h"
+#include "Trace.h"
 #include "Random.h"
 #include "ThreadPool.h"
 #include "Timing.h"
@@ -336,6 +338,17 @@ std::pair<int, int> Network::load_v1_network(std::istream& wtfile) {
     return {channels, static_cast<int>(residual_blocks)};
 }
 
+// 64-bit FNV-1a, which is stable across platforms and standard
+// library implementations, unlike std::hash.
+static std::uint64_t fnv1a_hash(const std::string& data) {
+    auto hash = std::uint64_t{0xcbf29ce484222325ULL};
+    for (const auto c : data) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
 std::pair<int, int> Network::load_network_file(const std::string& filename) {
     // gzopen supports both gz and non-gz files, will decompress
     // or just read directly as needed.
@@ -361,6 +374,10 @@ std::pair<int, int> Network::load_network_file(const std::string& filename) {
     }
     gzclose(gzhandle);
 
+    // Identify the network by its contents rather than its file name,
+    // so saved search trees can be matched up with it.
+    m_weights_hash = fnv1a_hash(buffer.str());
+
     // Read format version
     auto line = std::string{};
     auto format_version = -1;
@@ -703,7 +720,9 @@ std::vector<float> softmax(const std::vector<float>& input,
 
 bool Network::probe_cache(const GameState* const state,
                           Network::Netresult& result) {
+    Trace::Span span("nn cache", 0);
     if (m_nncache.lookup(state->board.get_hash(), result)) {
+        span.set_arg(1);
         return true;
     }
     // If we are not generating a self-play game, try to find
@@ -723,6 +742,7 @@ bool Network::probe_cache(const GameState* const state,
                     corrected_policy[idx] = result.policy[sym_idx];
                 }
                 result.policy = std::move(corrected_policy);
+                span.set_arg(1);
                 return true;
             }
         }
@@ -734,6 +754,8 @@ bool Network::probe_cache(const GameState* const state,
 Network::Netresult Network::get_output(
     const GameState* const state, const Ensemble ensemble, const int symmetry,
     const bool read_cache, const bool write_cache, const bool force_selfcheck) {
+    PROFILE_PHASE(NN_EVAL);
+
     Netresult result;
     if (state->board.get_boardsize() != BOARD_SIZE) {
         return result;
@@ -905,7 +927,7 @@ void Network::show_heatmap(const FastState* const state,
     }
 }
 
-void Network::fill_input_plane_pair(const FullBoard& board,
+void Network::fill_input_plane_pair(const GameBoard& board,
                                     std::vector<float>::iterator black,
                                     std::vector<float>::iterator white,
                                     const int symmetry) {
@@ -982,6 +1004,10 @@ std::pair<int, int> Network::get_symmetry(const std::pair<int, int>& vertex,
     return {x, y};
 }
 
+std::uint64_t Network::get_weights_hash() const {
+    return m_weights_hash;
+}
+
 size_t Network::get_estimated_size() {
     if (estimated_size != 0) {
         return estimated_size;
@@ -1033,3 +1059,11 @@ size_t Network::get_estimated_cache_size() {
 void Network::nncache_resize(int max_count) {
     return m_nncache.resize(max_count);
 }
+
+std::pair<int, int> Network::get_cache_hit_rate() const {
+    return m_nncache.hit_rate();
+}
+
+ForwardPipe::BatchStats Network::get_batch_stats() const {
+    return m_forward->get_batch_stats();
+}
@@ -34,6 +34,7 @@
 
 #include <deque>
 #include <array>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <utility>
@@ -103,7 +104,11 @@ public:
 
     size_t get_estimated_size();
     size_t get_estimated_cache_size();
+    std::uint64_t get_weights_hash() const;
     void nncache_resize(int max_count);
+    // NN cache hits and lookups so far.
+    std::pair<int, int> get_cache_hit_rate() const;
+    ForwardPipe::BatchStats get_batch_stats() const;
 
 private:
     std::pair<int, int> load_v1_network(std::istream& wtfile);
@@ -131,7 +136,7 @@ private:
                                std::vector<float>& M, const int C, const int K);
     Netresult get_output_internal(const GameState* const state,
                                   const int symmetry, bool selfcheck = false);
-    static void fill_input_plane_pair(const FullBoard& board,
+    static void fill_input_plane_pair(const GameBoard& board,
                                       std::vector<float>::iterator black,
                                       std::vector<float>::iterator white,
                                       const int symmetry);
@@ -151,6 +156,9 @@ private:
 
     size_t estimated_size{0};
 
+    // Hash of the uncompressed weights file
+    std::uint64_t m_weights_hash{0};
+
     // Residual tower
     std::shared_ptr<ForwardPipeWeights> m_fwd_weights;
 
@@ -31,6 +31,8 @@
 #ifdef USE_OPENCL
 
 #include "GTP.h"
+#include "Profiler.h"
+#include "Trace.h"
 #include "Random.h"
 #include "Network.h"
 #include "Utils.h"
@@ -266,6 +268,9 @@ template <typename net_t>
 void OpenCLScheduler<net_t>::forward(const std::vector<float>& input,
                                      std::vector<float>& output_pol,
                                      std::vector<float>& output_val) {
+    PROFILE_PHASE(NN_QUEUE);
+    Trace::Span span("nn queue");
+
     auto entry = std::make_shared<ForwardQueueEntry>(input, output_pol, output_val);
     std::unique_lock<std::mutex> lk(entry->mutex);
     {
@@ -280,6 +285,14 @@ void OpenCLScheduler<net_t>::forward(const std::vector<float>& input,
     entry->cv.wait(lk);
 }
 
+template <typename net_t>
+ForwardPipe::BatchStats OpenCLScheduler<net_t>::get_batch_stats() const {
+    auto stats = BatchStats{};
+    stats.batches = m_batches.load();
+    stats.positions = m_batched_positions.load();
+    return stats;
+}
+
 #ifndef NDEBUG
 struct batch_stats_t batch_stats;
 #endif
@@ -311,6 +324,7 @@ void OpenCLScheduler<net_t>::batch_worker(const size_t gnum) {
     // the wrong decision.  Wait 2ms longer next time.
 
     auto pickup_task = [this] () {
+        Trace::Span span("batch wait");
         std::list<std::shared_ptr<ForwardQueueEntry>> inputs;
         size_t count = 0;
 
@@ -366,6 +380,8 @@ void OpenCLScheduler<net_t>::batch_worker(const size_t gnum) {
             return;
         }
 
+        m_batches++;
+        m_batched_positions += count;
 #ifndef NDEBUG
         if (count == 1) {
             batch_stats.single_evals++;
@@ -387,8 +403,12 @@ void OpenCLScheduler<net_t>::batch_worker(const size_t gnum) {
         }
 
         // run the NN evaluation
-        m_networks[gnum]->forward(
-            batch_input, batch_output_pol, batch_output_val, context, count);
+        {
+            PROFILE_PHASE(NN_FORWARD);
+            Trace::Span span("nn forward", count);
+            m_networks[gnum]->forward(
+                batch_input, batch_output_pol, batch_output_val, context, count);
+        }
 
         // Get output and copy back
         index = 0;
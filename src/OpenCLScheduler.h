@@ -76,6 +76,7 @@ public:
                               unsigned int channels,
                               unsigned int outputs,
                               std::shared_ptr<const ForwardPipeWeights> weights);
+    virtual BatchStats get_batch_stats() const;
 private:
     bool m_running = true;
     std::vector<std::unique_ptr<OpenCL_Network<net_t>>> m_networks;
@@ -91,6 +92,8 @@ private:
     std::atomic<bool> m_single_eval_in_progress{false};
 
     std::list<std::shared_ptr<ForwardQueueEntry>> m_forward_queue;
+    std::atomic<size_t> m_batches{0};
+    std::atomic<size_t> m_batched_positions{0};
     std::list<std::thread> m_worker_threads;
 
     void batch_worker(const size_t gnum);
@@ -0,0 +1,165 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#include "config.h"
+#include "Profiler.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <boost/format.hpp>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILER_HAVE_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_HAVE_TSC
+#endif
+
+using namespace Profiler;
+
+namespace {
+    struct ThreadCounters {
+        ThreadCounters() {
+            for (auto i = 0; i < NUM_PHASES; i++) {
+                calls[i] = 0;
+                ticks[i] = 0;
+                depth[i] = 0;
+                start[i] = 0;
+            }
+        }
+        // Read and cleared by other threads.
+        std::array<std::atomic<std::uint64_t>, NUM_PHASES> calls;
+        std::array<std::atomic<std::uint64_t>, NUM_PHASES> ticks;
+        // Only used by the owning thread.
+        std::array<int, NUM_PHASES> depth;
+        std::array<std::uint64_t, NUM_PHASES> start;
+    };
+
+    const std::array<const char*, NUM_PHASES> s_phase_names = {
+        "playout", "state copy", "select", "expand",
+        "nn eval", "nn queue", "nn forward", "backup"
+    };
+
+    std::mutex s_mutex;
+    std::vector<std::shared_ptr<ThreadCounters>> s_counters;
+    // Used to convert ticks to time.
+    std::uint64_t s_reset_ticks;
+    std::chrono::steady_clock::time_point s_reset_time;
+}
+
+static std::uint64_t timestamp() {
+#ifdef PROFILER_HAVE_TSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static ThreadCounters& thread_counters() {
+    // Shared with s_counters so a report can still read
+    // the counters of a thread that has exited.
+    thread_local auto counters = [] {
+        auto counters = std::make_shared<ThreadCounters>();
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (s_counters.empty()) {
+            s_reset_ticks = timestamp();
+            s_reset_time = std::chrono::steady_clock::now();
+        }
+        s_counters.emplace_back(counters);
+        return counters;
+    }();
+    return *counters;
+}
+
+void Profiler::enter(Phase phase) {
+    auto& counters = thread_counters();
+    if (counters.depth[phase]++ == 0) {
+        counters.start[phase] = timestamp();
+    }
+}
+
+void Profiler::leave(Phase phase) {
+    auto& counters = thread_counters();
+    if (--counters.depth[phase] == 0) {
+        const auto ticks = timestamp() - counters.start[phase];
+        counters.calls[phase].fetch_add(1, std::memory_order_relaxed);
+        counters.ticks[phase].fetch_add(ticks, std::memory_order_relaxed);
+    }
+}
+
+void Profiler::reset() {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    for (const auto& counters : s_counters) {
+        for (auto i = 0; i < NUM_PHASES; i++) {
+            counters->calls[i] = 0;
+            counters->ticks[i] = 0;
+        }
+    }
+    s_reset_ticks = timestamp();
+    s_reset_time = std::chrono::steady_clock::now();
+}
+
+std::string Profiler::get_report() {
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    auto calls = std::array<std::uint64_t, NUM_PHASES>{};
+    auto ticks = std::array<std::uint64_t, NUM_PHASES>{};
+    for (const auto& counters : s_counters) {
+        for (auto i = 0; i < NUM_PHASES; i++) {
+            calls[i] += counters->calls[i].load(std::memory_order_relaxed);
+            ticks[i] += counters->ticks[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    // Calibrate the tick rate against the wall clock since the reset.
+    const auto elapsed_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - s_reset_time).count();
+    const auto elapsed_ticks = timestamp() - s_reset_ticks;
+    const auto ticks_per_us = elapsed_us > 0 ?
+        double(elapsed_ticks) / elapsed_us : 1000.0;
+
+    auto report = str(boost::format("%-11s %10s %11s %9s %8s\n")
+        % "phase" % "calls" % "ms" % "us/call" % "playout");
+    for (auto i = 0; i < NUM_PHASES; i++) {
+        const auto us = ticks[i] / ticks_per_us;
+        const auto share = ticks[PLAYOUT] > 0 ?
+            100.0 * ticks[i] / ticks[PLAYOUT] : 0.0;
+        report += str(boost::format("%-11s %10d %11.1f %9.2f %7.1f%%\n")
+            % s_phase_names[i] % calls[i] % (us / 1000.0)
+            % (calls[i] > 0 ? us / calls[i] : 0.0) % share);
+    }
+    return report;
+}
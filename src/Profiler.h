@@ -0,0 +1,89 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#ifndef PROFILER_H_INCLUDED
+#define PROFILER_H_INCLUDED
+
+#include "config.h"
+
+#include <cstdint>
+#include <string>
+
+/*
+    Per-phase timing of the search. Every thread counts the calls to and
+    the time spent in each phase of a playout. Nested or recursive entries
+    into a phase the thread is already in are not counted again.
+
+    The instrumentation in the hot paths only exists when building with
+    USE_PROFILER, see config.h.
+*/
+namespace Profiler {
+    enum Phase {
+        PLAYOUT = 0,    // UCTSearch::play_simulation from the root
+        STATE_COPY,     // copying the root GameState for a playout
+        SELECT,         // UCTNode::uct_select_child
+        EXPAND,         // UCTNode::create_children, NN evaluation included
+        NN_EVAL,        // Network::get_output, cache lookup included
+        NN_QUEUE,       // waiting for the OpenCL scheduler to run our batch
+        NN_FORWARD,     // running the network
+        BACKUP,         // UCTNode::update
+        NUM_PHASES
+    };
+
+    void enter(Phase phase);
+    void leave(Phase phase);
+
+    // Clear the counters of all threads.
+    void reset();
+    // Table of the counters since the last reset.
+    std::string get_report();
+
+    class ScopedPhase {
+    public:
+        explicit ScopedPhase(Phase phase) : m_phase(phase) {
+            enter(m_phase);
+        }
+        ~ScopedPhase() {
+            leave(m_phase);
+        }
+        ScopedPhase(const ScopedPhase&) = delete;
+        ScopedPhase& operator=(const ScopedPhase&) = delete;
+    private:
+        Phase m_phase;
+    };
+}
+
+#ifdef USE_PROFILER
+#define PROFILE_PHASE(phase) \
+    Profiler::ScopedPhase profiler_scoped_phase{Profiler::phase}
+#else
+#define PROFILE_PHASE(phase)
+#endif
+
+#endif
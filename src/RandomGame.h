@@ -0,0 +1,94 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#ifndef RANDOMGAME_H_INCLUDED
+#define RANDOMGAME_H_INCLUDED
+
+#include "config.h"
+
+#include <vector>
+
+#include "FastBoard.h"
+#include "Random.h"
+
+struct RandomGameOptions {
+    // The game stops after this many moves, or earlier when the side
+    // to move has nothing left to play but its own eyes.
+    int max_moves{3 * NUM_INTERSECTIONS};
+    // Pass instead of moving one time in pass_odds, and keep passing
+    // rather than stop when there is nothing left to play. 0 never passes.
+    int pass_odds{0};
+    // Pick the color of each move at random and play on any empty
+    // point, suicides included, to stress the board rather than play Go.
+    bool anything_goes{false};
+};
+
+/*
+    Play a seeded random game from state, a KoState or a GameState,
+    never filling own eyes, and call on_move(state, color, vertex)
+    after each move. The game stops early when on_move returns false.
+*/
+template <typename State, typename OnMove>
+void play_random_game(State& state, Random& rng,
+                      const RandomGameOptions& options, OnMove on_move) {
+    const auto boardsize = state.board.get_boardsize();
+    auto candidates = std::vector<int>{};
+    for (auto movenum = 0; movenum < options.max_moves; movenum++) {
+        auto color = state.get_to_move();
+        if (options.anything_goes) {
+            color = int(rng.randuint64(2));
+        }
+        candidates.clear();
+        for (auto y = 0; y < boardsize; y++) {
+            for (auto x = 0; x < boardsize; x++) {
+                const auto vertex = state.board.get_vertex(x, y);
+                if (options.anything_goes
+                    ? state.board.get_state(vertex) == FastBoard::EMPTY
+                    : state.is_move_legal(color, vertex)
+                          && !state.board.is_eye(color, vertex)) {
+                    candidates.emplace_back(vertex);
+                }
+            }
+        }
+
+        auto move = FastBoard::PASS;
+        if (!candidates.empty() && (options.pass_odds == 0
+                                    || rng.randuint64(options.pass_odds) != 0)) {
+            move = candidates[rng.randuint64(candidates.size())];
+        } else if (options.pass_odds == 0) {
+            break;
+        }
+        state.play_move(color, move);
+        if (!on_move(state, color, move)) {
+            break;
+        }
+    }
+}
+
+#endif
@@ -128,6 +128,8 @@ public:
         for (auto && result : m_taskresults) {
             result.get();
         }
+        // Allow the group to be reused for a new batch of tasks.
+        m_taskresults.clear();
     }
 private:
     ThreadPool & m_pool;
@@ -0,0 +1,154 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#include "config.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace Trace;
+
+std::atomic<bool> Trace::s_enabled{false};
+
+namespace {
+    // One event of the ring, guarded by a sequence number so that a
+    // reader can tell a slot the owner is rewriting from a whole one:
+    // seq is i + 1 once event i is stored, and 0 while it is written.
+    struct Slot {
+        std::atomic<size_t> seq{0};
+        std::atomic<const char*> name{nullptr};
+        std::atomic<std::int64_t> start_us{0};
+        std::atomic<std::int64_t> end_us{0};
+        std::atomic<std::int64_t> arg{0};
+    };
+
+    // Written only by the owning thread. Readers take the events from
+    // m_begin up to m_count, and skip any slot whose sequence number
+    // does not match, so they never wait for the owner.
+    struct ThreadBuffer {
+        explicit ThreadBuffer(int tid) : m_tid(tid) {}
+        const int m_tid;
+        std::atomic<size_t> m_begin{0};
+        std::atomic<size_t> m_count{0};
+        std::array<Slot, TRACE_BUFFER_SIZE> m_slots{};
+    };
+
+    std::mutex s_mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> s_buffers;
+}
+
+static ThreadBuffer& thread_buffer() {
+    thread_local auto buffer = [] {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto buffer = std::make_shared<ThreadBuffer>(s_buffers.size());
+        s_buffers.emplace_back(buffer);
+        return buffer;
+    }();
+    return *buffer;
+}
+
+std::int64_t Trace::now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::record(const char* name, std::int64_t start_us,
+                   std::int64_t end_us, std::int64_t arg) {
+    auto& buffer = thread_buffer();
+    const auto count = buffer.m_count.load(std::memory_order_relaxed);
+    auto& slot = buffer.m_slots[count % TRACE_BUFFER_SIZE];
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start_us.store(start_us, std::memory_order_relaxed);
+    slot.end_us.store(end_us, std::memory_order_relaxed);
+    slot.arg.store(arg, std::memory_order_relaxed);
+    slot.seq.store(count + 1, std::memory_order_release);
+    buffer.m_count.store(count + 1, std::memory_order_release);
+}
+
+void Trace::start() {
+    // The owners may still be recording, for example tree deletions
+    // left running in the background, so only move the start mark.
+    std::lock_guard<std::mutex> lock(s_mutex);
+    for (const auto& buffer : s_buffers) {
+        buffer->m_begin = buffer->m_count.load(std::memory_order_acquire);
+    }
+    s_enabled = true;
+}
+
+bool Trace::stop(const std::string& filename) {
+    s_enabled = false;
+
+    std::ofstream out(filename);
+    if (!out) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(s_mutex);
+    out << "{\"traceEvents\":[";
+    auto first = true;
+    for (const auto& buffer : s_buffers) {
+        const auto count = buffer->m_count.load(std::memory_order_acquire);
+        const auto oldest = std::max(buffer->m_begin.load(),
+            count > size_t{TRACE_BUFFER_SIZE} ?
+                count - TRACE_BUFFER_SIZE : size_t{0});
+        for (auto i = oldest; i < count; i++) {
+            const auto& slot = buffer->m_slots[i % TRACE_BUFFER_SIZE];
+            const auto seq = slot.seq.load(std::memory_order_acquire);
+            const auto name = slot.name.load(std::memory_order_relaxed);
+            const auto start_us = slot.start_us.load(std::memory_order_relaxed);
+            const auto end_us = slot.end_us.load(std::memory_order_relaxed);
+            const auto arg = slot.arg.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // Overwritten by a later event since, or being overwritten.
+            if (seq != i + 1
+                || slot.seq.load(std::memory_order_relaxed) != seq) {
+                continue;
+            }
+            out << (first ? "\n" : ",\n");
+            first = false;
+            out << "{\"name\":\"" << name << "\",\"ph\":\"X\""
+                << ",\"ts\":" << start_us
+                << ",\"dur\":" << end_us - start_us
+                << ",\"pid\":0,\"tid\":" << buffer->m_tid;
+            if (arg >= 0) {
+                out << ",\"args\":{\"n\":" << arg << "}";
+            }
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+    out.close();
+    return bool(out);
+}
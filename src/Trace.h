@@ -0,0 +1,94 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#ifndef TRACE_H_INCLUDED
+#define TRACE_H_INCLUDED
+
+#include "config.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/*
+    Timeline tracing of the search, for finding stalls. While tracing
+    is on, every thread records the spans it runs into its own ring
+    buffer, which keeps the most recent TRACE_BUFFER_SIZE spans. The
+    buffers can be written out as a Chrome trace-event JSON file, which
+    chrome://tracing and Perfetto can display.
+*/
+namespace Trace {
+    static constexpr auto TRACE_BUFFER_SIZE = 1 << 16;
+
+    extern std::atomic<bool> s_enabled;
+
+    inline bool enabled() {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    // Clear the buffers and start recording.
+    void start();
+    // Stop recording and write the buffers to filename.
+    bool stop(const std::string& filename);
+
+    std::int64_t now_us();
+    void record(const char* name, std::int64_t start_us,
+                std::int64_t end_us, std::int64_t arg);
+
+    // Records the lifetime of the object as a span. The name must be
+    // a string literal or otherwise outlive the trace.
+    class Span {
+    public:
+        explicit Span(const char* name, std::int64_t arg = -1) {
+            if (enabled()) {
+                m_name = name;
+                m_arg = arg;
+                m_start = now_us();
+            }
+        }
+        ~Span() {
+            if (m_name) {
+                record(m_name, m_start, now_us(), m_arg);
+            }
+        }
+        // Attach a number to the span, shown as its argument.
+        void set_arg(std::int64_t arg) {
+            m_arg = arg;
+        }
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+    private:
+        const char* m_name{nullptr};
+        std::int64_t m_arg{-1};
+        std::int64_t m_start{0};
+    };
+}
+
+#endif
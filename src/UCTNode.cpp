@@ -35,9 +35,11 @@
 #include <algorithm>
 #include <cmath>
 #include <functional>
+#include <istream>
 #include <iterator>
 #include <limits>
 #include <numeric>
+#include <ostream>
 #include <utility>
 #include <vector>
 
@@ -46,16 +48,28 @@
 #include "FastState.h"
 #include "GTP.h"
 #include "GameState.h"
+#include "Ladder.h"
 #include "Network.h"
+#include "Profiler.h"
+#include "Trace.h"
 #include "Utils.h"
 
 using namespace Utils;
 
+// Layout of UCTNode::m_visits_vl.
+static constexpr auto VISITS_MASK = std::uint64_t{0xffffffff};
+static constexpr auto VIRTUAL_LOSS_SHIFT = 32;
+// Fixed point scale of UCTNode::m_blackevals. Leaves room
+// for 2^33 visits with evals in [0, 1].
+static constexpr auto BLACKEVALS_SCALE = double(1 << 30);
+// Policy kept by moves that escape from a ladder that still works.
+static constexpr auto LADDER_ESCAPE_FACTOR = 0.1f;
+
 UCTNode::UCTNode(int vertex, float policy) : m_move(vertex), m_policy(policy) {
 }
 
 bool UCTNode::first_visit() const {
-    return m_visits == 0;
+    return get_visits() == 0;
 }
 
 bool UCTNode::create_children(Network & network,
@@ -63,6 +77,36 @@ bool UCTNode::create_children(Network & network,
                               GameState& state,
                               float& eval,
                               float min_psa_ratio) {
+    PROFILE_PHASE(EXPAND);
+    Trace::Span span("expand");
+
+    if (!acquire_expansion(state, min_psa_ratio)) {
+        return false;
+    }
+
+    const auto raw_netlist = network.get_output(
+        &state, Network::Ensemble::RANDOM_SYMMETRY);
+    expand_from(raw_netlist, nodecount, state, eval, min_psa_ratio);
+    return true;
+}
+
+bool UCTNode::create_children(const Network::Netresult& raw_netlist,
+                              std::atomic<int>& nodecount,
+                              GameState& state,
+                              float& eval,
+                              float min_psa_ratio) {
+    PROFILE_PHASE(EXPAND);
+
+    if (!acquire_expansion(state, min_psa_ratio)) {
+        return false;
+    }
+
+    expand_from(raw_netlist, nodecount, state, eval, min_psa_ratio);
+    return true;
+}
+
+bool UCTNode::acquire_expansion(const GameState& state,
+                                float min_psa_ratio) {
     // no successors in final state
     if (state.get_passes() >= 2) {
         return false;
@@ -78,10 +122,14 @@ bool UCTNode::create_children(Network & network,
         expand_done();
         return false;
     }
+    return true;
+}
 
-    const auto raw_netlist = network.get_output(
-        &state, Network::Ensemble::RANDOM_SYMMETRY);
-
+void UCTNode::expand_from(const Network::Netresult& raw_netlist,
+                          std::atomic<int>& nodecount,
+                          GameState& state,
+                          float& eval,
+                          float min_psa_ratio) {
     // DCNN returns winrate as side to move
     const auto stm_eval = raw_netlist.winrate;
     const auto to_move = state.board.get_to_move();
@@ -95,14 +143,21 @@ bool UCTNode::create_children(Network & network,
 
     std::vector<Network::PolicyVertexPair> nodelist;
 
+    const auto legal_moves = state.get_legal_moves(to_move);
+    const auto read_ladders =
+        cfg_read_ladders && Ladder::has_atari(state.board, to_move);
     auto legal_sum = 0.0f;
     for (auto i = 0; i < NUM_INTERSECTIONS; i++) {
-        const auto x = i % BOARD_SIZE;
-        const auto y = i / BOARD_SIZE;
-        const auto vertex = state.board.get_vertex(x, y);
-        if (state.is_move_legal(to_move, vertex)) {
-            nodelist.emplace_back(raw_netlist.policy[i], vertex);
-            legal_sum += raw_netlist.policy[i];
+        if (legal_moves[i]) {
+            const auto x = i % BOARD_SIZE;
+            const auto y = i / BOARD_SIZE;
+            const auto vertex = state.board.get_vertex(x, y);
+            auto policy = raw_netlist.policy[i];
+            if (read_ladders && Ladder::is_ladder_escape(state, vertex)) {
+                policy *= LADDER_ESCAPE_FACTOR;
+            }
+            nodelist.emplace_back(policy, vertex);
+            legal_sum += policy;
         }
     }
 
@@ -144,7 +199,6 @@ bool UCTNode::create_children(Network & network,
 
     link_nodelist(nodecount, nodelist, min_psa_ratio);
     expand_done();
-    return true;
 }
 
 void UCTNode::link_nodelist(std::atomic<int>& nodecount,
@@ -195,19 +249,21 @@ int UCTNode::get_move() const {
 }
 
 void UCTNode::virtual_loss() {
-    m_virtual_loss += VIRTUAL_LOSS_COUNT;
+    m_visits_vl += std::uint64_t{VIRTUAL_LOSS_COUNT} << VIRTUAL_LOSS_SHIFT;
 }
 
 void UCTNode::virtual_loss_undo() {
-    m_virtual_loss -= VIRTUAL_LOSS_COUNT;
+    m_visits_vl -= std::uint64_t{VIRTUAL_LOSS_COUNT} << VIRTUAL_LOSS_SHIFT;
 }
 
 void UCTNode::update(float eval) {
+    PROFILE_PHASE(BACKUP);
+
     // Cache values to avoid race conditions.
-    auto old_eval = static_cast<float>(m_blackevals);
-    auto old_visits = static_cast<int>(m_visits);
+    auto old_eval = static_cast<float>(get_blackevals());
+    auto old_visits = get_visits();
     auto old_delta = old_visits > 0 ? eval - old_eval / old_visits : 0.0f;
-    m_visits++;
+    m_visits_vl++;
     accumulate_eval(eval);
     auto new_delta = eval - (old_eval + eval) / (old_visits + 1);
     // Welford's online algorithm for calculating variance.
@@ -239,11 +295,12 @@ void UCTNode::set_policy(float policy) {
 }
 
 float UCTNode::get_eval_variance(float default_var) const {
-    return m_visits > 1 ? m_squared_eval_diff / (m_visits - 1) : default_var;
+    const auto visits = get_visits();
+    return visits > 1 ? m_squared_eval_diff / (visits - 1) : default_var;
 }
 
 int UCTNode::get_visits() const {
-    return m_visits;
+    return static_cast<int>(m_visits_vl.load() & VISITS_MASK);
 }
 
 float UCTNode::get_eval_lcb(int color) const {
@@ -262,7 +319,11 @@ float UCTNode::get_eval_lcb(int color) const {
 }
 
 float UCTNode::get_raw_eval(int tomove, int virtual_loss) const {
-    auto visits = get_visits() + virtual_loss;
+    return get_raw_eval(tomove, get_visits(), virtual_loss);
+}
+
+float UCTNode::get_raw_eval(int tomove, int visits, int virtual_loss) const {
+    visits += virtual_loss;
     assert(visits > 0);
     auto blackeval = get_blackevals();
     if (tomove == FastBoard::WHITE) {
@@ -279,7 +340,11 @@ float UCTNode::get_eval(int tomove) const {
     // Due to the use of atomic updates and virtual losses, it is
     // possible for the visit count to change underneath us. Make sure
     // to return a consistent result to the caller by caching the values.
-    return get_raw_eval(tomove, m_virtual_loss);
+    const auto visits_vl = m_visits_vl.load();
+    const auto visits = static_cast<int>(visits_vl & VISITS_MASK);
+    const auto virtual_loss =
+        static_cast<int>(visits_vl >> VIRTUAL_LOSS_SHIFT);
+    return get_raw_eval(tomove, visits, virtual_loss);
 }
 
 float UCTNode::get_net_eval(int tomove) const {
@@ -290,14 +355,15 @@ float UCTNode::get_net_eval(int tomove) const {
 }
 
 double UCTNode::get_blackevals() const {
-    return m_blackevals;
+    return m_blackevals.load() / BLACKEVALS_SCALE;
 }
 
 void UCTNode::accumulate_eval(float eval) {
-    atomic_add(m_blackevals, double(eval));
+    m_blackevals += std::llround(eval * BLACKEVALS_SCALE);
 }
 
 UCTNode* UCTNode::uct_select_child(int color, bool is_root) {
+    PROFILE_PHASE(SELECT);
     wait_expanded();
 
     // Count parentvisits manually to avoid issues with transpositions.
@@ -433,6 +499,201 @@ size_t UCTNode::count_nodes_and_clear_expand_state() {
     return nodecount;
 }
 
+// Same as above, but the subtrees of the children are walked in
+// parallel on the thread pool. Meant for the root, where the tree
+// can hold tens of millions of nodes.
+size_t UCTNode::count_nodes_and_clear_expand_state(ThreadPool& pool) {
+    std::atomic<size_t> nodecount{m_children.size()};
+    if (expandable()) {
+        m_expand_state = ExpandState::INITIAL;
+    }
+    ThreadGroup tg(pool);
+    for (auto& child : m_children) {
+        if (child.is_inflated()) {
+            const auto node = child.get();
+            tg.add_task([node, &nodecount]() {
+                Trace::Span span("count nodes");
+                nodecount += node->count_nodes_and_clear_expand_state();
+            });
+        }
+    }
+    tg.wait_all();
+    return nodecount;
+}
+
+// Memory held by the subtree below this node, in the same units
+// as UCTNodePointer::get_tree_size().
+size_t UCTNode::get_tree_memory() const {
+    auto size = m_children.size() * sizeof(UCTNodePointer);
+    for (const auto& child : m_children) {
+        if (child.is_inflated()) {
+            size += sizeof(UCTNode) + child->get_tree_memory();
+        }
+    }
+    return size;
+}
+
+// Turn every descendant with less than min_visits visits back into its
+// uninflated form. The detached subtrees are handed to the caller, which
+// is responsible for deleting them. Returns the amount of tree memory
+// that will be released once they are (the detached nodes themselves
+// are already accounted for). Must not be called while other threads
+// are searching below this node.
+size_t UCTNode::deflate_children(const int min_visits,
+                                 std::vector<UCTNode*>& detached) {
+    auto pending = size_t{0};
+    for (auto& child : m_children) {
+        // Deflating would lose the superko flag of invalid nodes,
+        // and they have no subtree to release anyway.
+        if (!child.is_inflated() || !child.valid()) {
+            continue;
+        }
+        if (child.get_visits() < min_visits) {
+            auto node = child.deflate();
+            pending += node->get_tree_memory();
+            detached.emplace_back(node);
+        } else {
+            pending += child->deflate_children(min_visits, detached);
+        }
+    }
+    return pending;
+}
+
+// Add the memory of every descendant that deflate_children would release,
+// without its subtree, to memory[n], where n is the number of bits in its
+// visit count. As visits never grow from a node to its children, the sum
+// of memory[0] to memory[n] is what deflate_children(1 << n) releases.
+void UCTNode::tally_memory_by_visits(std::vector<size_t>& memory) const {
+    for (const auto& child : m_children) {
+        if (!child.is_inflated() || !child.valid()) {
+            continue;
+        }
+        auto bits = size_t{0};
+        for (auto visits = child.get_visits(); visits > 0; visits >>= 1) {
+            bits++;
+        }
+        memory[bits] += sizeof(UCTNode)
+            + child->m_children.size() * sizeof(UCTNodePointer);
+        child->tally_memory_by_visits(memory);
+    }
+}
+
+// Deflate every inflated child and hand the subtrees to the caller for
+// deletion. Unlike deflate_children, nothing is measured, so this costs
+// one pass over the children. Used when the whole tree goes away.
+void UCTNode::detach_children(std::vector<UCTNode*>& detached) {
+    for (auto& child : m_children) {
+        if (child.is_inflated()) {
+            detached.emplace_back(child.deflate());
+        }
+    }
+}
+
+static bool valid_move(const int move) {
+    return move == FastBoard::PASS
+        || (move >= 0 && move < FastBoard::NUM_VERTICES);
+}
+
+// Tree is written depth first, in little-endian byte order. Uninflated
+// children only store their move and policy, like UCTNodePointer does.
+void UCTNode::save(std::ostream& out) const {
+    write_le<std::int16_t>(out, m_move);
+    write_le<std::int32_t>(out, get_visits());
+    write_le<float>(out, m_policy);
+    write_le<float>(out, m_net_eval);
+    write_le<float>(out, m_squared_eval_diff.load());
+    write_le<double>(out, get_blackevals());
+    write_le<std::uint8_t>(out, m_status.load());
+    write_le<std::uint8_t>(out,
+        m_expand_state.load() == ExpandState::EXPANDED);
+    write_le<float>(out, m_min_psa_ratio_children.load());
+
+    write_le<std::uint16_t>(out, m_children.size());
+    for (const auto& child : m_children) {
+        write_le<std::uint8_t>(out, child.is_inflated());
+        if (child.is_inflated()) {
+            child->save(out);
+        } else {
+            write_le<std::int16_t>(out, child.get_move());
+            write_le<float>(out, child.get_policy());
+        }
+    }
+}
+
+// Read the statistics of this node as written by save() and make room
+// for its children. Returns how many children follow, or -1 on a read
+// error or malformed data.
+int UCTNode::load_stats(std::istream& in) {
+    m_move = read_le<std::int16_t>(in);
+    const auto visits = read_le<std::int32_t>(in);
+    m_policy = read_le<float>(in);
+    m_net_eval = read_le<float>(in);
+    m_squared_eval_diff = read_le<float>(in);
+    const auto blackevals = read_le<double>(in);
+    const auto status = read_le<std::uint8_t>(in);
+    const auto expanded = read_le<std::uint8_t>(in);
+    m_min_psa_ratio_children = read_le<float>(in);
+    const auto num_children = read_le<std::uint16_t>(in);
+
+    // At most one child per intersection, plus pass.
+    if (!in || !valid_move(m_move) || visits < 0 || status > ACTIVE
+        || num_children > NUM_INTERSECTIONS + 1) {
+        return -1;
+    }
+    m_visits_vl = static_cast<std::uint64_t>(visits);
+    m_blackevals = std::llround(blackevals * BLACKEVALS_SCALE);
+    m_status = static_cast<Status>(status);
+    m_expand_state = expanded ? ExpandState::EXPANDED : ExpandState::INITIAL;
+    m_children.reserve(num_children);
+    return num_children;
+}
+
+// Counterpart of save(). Must be called on a freshly constructed node.
+// Returns false on a read error or malformed data, in which case
+// the node is left in an unspecified state. The file may come from
+// anywhere, so the nodes are read with an explicit stack rather than
+// by recursion, however deep they are nested.
+bool UCTNode::load(std::istream& in) {
+    assert(m_children.empty());
+
+    // Nodes still reading their children, and how many are left.
+    auto stack = std::vector<std::pair<UCTNode*, int>>{};
+    const auto num_children = load_stats(in);
+    if (num_children < 0) {
+        return false;
+    }
+    stack.emplace_back(this, num_children);
+    while (!stack.empty()) {
+        const auto node = stack.back().first;
+        if (stack.back().second-- == 0) {
+            stack.pop_back();
+            continue;
+        }
+        const auto inflated = read_le<std::uint8_t>(in);
+        if (!in) {
+            return false;
+        }
+        if (inflated) {
+            node->m_children.emplace_back(FastBoard::PASS, 0.0f);
+            node->m_children.back().inflate();
+            const auto child = node->m_children.back().get();
+            const auto child_children = child->load_stats(in);
+            if (child_children < 0) {
+                return false;
+            }
+            stack.emplace_back(child, child_children);
+        } else {
+            const auto move = read_le<std::int16_t>(in);
+            const auto policy = read_le<float>(in);
+            if (!in || !valid_move(move)) {
+                return false;
+            }
+            node->m_children.emplace_back(move, policy);
+        }
+    }
+    return true;
+}
+
 void UCTNode::invalidate() {
     m_status = INVALID;
 }
@@ -472,7 +733,10 @@ void UCTNode::expand_cancel() {
     assert(v == ExpandState::EXPANDING);
 }
 void UCTNode::wait_expanded() {
-    while (m_expand_state.load() == ExpandState::EXPANDING) {}
+    if (m_expand_state.load() == ExpandState::EXPANDING) {
+        Trace::Span span("wait expanded");
+        while (m_expand_state.load() == ExpandState::EXPANDING) {}
+    }
     auto v = m_expand_state.load();
 #ifdef NDEBUG
     (void)v;
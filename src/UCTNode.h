@@ -33,6 +33,7 @@
 #include "config.h"
 
 #include <atomic>
+#include <iosfwd>
 #include <memory>
 #include <vector>
 #include <cassert>
@@ -41,6 +42,7 @@
 #include "GameState.h"
 #include "Network.h"
 #include "SMP.h"
+#include "ThreadPool.h"
 #include "UCTNodePointer.h"
 
 class UCTNode {
@@ -58,6 +60,11 @@ public:
                          std::atomic<int>& nodecount,
                          GameState& state, float& eval,
                          float min_psa_ratio = 0.0f);
+    // Same, with the network output for state already known.
+    bool create_children(const Network::Netresult& raw_netlist,
+                         std::atomic<int>& nodecount,
+                         GameState& state, float& eval,
+                         float min_psa_ratio = 0.0f);
 
     const std::vector<UCTNodePointer>& get_children() const;
     void sort_children(int color, float lcb_min_visits);
@@ -65,6 +72,11 @@ public:
     UCTNode* uct_select_child(int color, bool is_root);
 
     size_t count_nodes_and_clear_expand_state();
+    size_t count_nodes_and_clear_expand_state(Utils::ThreadPool& pool);
+    size_t get_tree_memory() const;
+    size_t deflate_children(int min_visits, std::vector<UCTNode*>& detached);
+    void tally_memory_by_visits(std::vector<size_t>& memory) const;
+    void detach_children(std::vector<UCTNode*>& detached);
     bool first_visit() const;
     bool has_children() const;
     bool expandable(const float min_psa_ratio = 0.0f) const;
@@ -89,27 +101,41 @@ public:
     void randomize_first_proportionally();
     void prepare_root_node(Network & network, int color,
                            std::atomic<int>& nodecount,
-                           GameState& state);
+                           GameState& state, bool add_noise = true);
 
     UCTNode* get_first_child() const;
     UCTNode* get_nopass_child(FastState& state) const;
     std::unique_ptr<UCTNode> find_child(const int move);
     void inflate_all_children();
+    void summarize_roots(const std::vector<const UCTNode*>& roots);
 
     void clear_expand_state();
+
+    // Write/read this node and its subtree, used by
+    // UCTSearch::save_tree and UCTSearch::load_tree.
+    void save(std::ostream& out) const;
+    bool load(std::istream& in);
 private:
     enum Status : char {
         INVALID, // superko
         PRUNED,
         ACTIVE
     };
+    bool acquire_expansion(const GameState& state, float min_psa_ratio);
+    void expand_from(const Network::Netresult& raw_netlist,
+                     std::atomic<int>& nodecount,
+                     GameState& state, float& eval,
+                     float min_psa_ratio);
     void link_nodelist(std::atomic<int>& nodecount,
                        std::vector<Network::PolicyVertexPair>& nodelist,
                        float min_psa_ratio);
+    float get_raw_eval(int tomove, int visits, int virtual_loss) const;
     double get_blackevals() const;
     void accumulate_eval(float eval);
     void kill_superkos(const GameState& state);
     void dirichlet_noise(float epsilon, float alpha);
+    void merge_stats(const UCTNode& other);
+    int load_stats(std::istream& in);
 
     // Note : This class is very size-sensitive as we are going to create
     // tens of millions of instances of these.  Please put extra caution
@@ -117,18 +143,6 @@ private:
 
     // Move
     std::int16_t m_move;
-    // UCT
-    std::atomic<std::int16_t> m_virtual_loss{0};
-    std::atomic<int> m_visits{0};
-    // UCT eval
-    float m_policy;
-    // Original net eval for this node (not children).
-    float m_net_eval{0.0f};
-    // Variable used for calculating variance of evaluations.
-    // Initialized to small non-zero value to avoid accidental zero variances
-    // at low visits.
-    std::atomic<float> m_squared_eval_diff{1e-4f};
-    std::atomic<double> m_blackevals{0.0};
     std::atomic<Status> m_status{ACTIVE};
 
     // m_expand_state acts as the lock for m_children.
@@ -148,6 +162,21 @@ private:
     };
     std::atomic<ExpandState> m_expand_state{ExpandState::INITIAL};
 
+    // UCT eval
+    float m_policy;
+    // Original net eval for this node (not children).
+    float m_net_eval{0.0f};
+    // Variable used for calculating variance of evaluations.
+    // Initialized to small non-zero value to avoid accidental zero variances
+    // at low visits.
+    std::atomic<float> m_squared_eval_diff{1e-4f};
+    // UCT. Visits in the low 32 bits and virtual losses in the high
+    // 32 bits, so that both are read and updated in a single operation.
+    std::atomic<std::uint64_t> m_visits_vl{0};
+    // Sum of the evals from black's point of view, in fixed point so it
+    // can be updated with fetch_add rather than a compare-exchange loop.
+    std::atomic<std::int64_t> m_blackevals{0};
+
     // Tree data
     std::atomic<float> m_min_psa_ratio_children{2.0f};
     std::vector<UCTNodePointer> m_children;
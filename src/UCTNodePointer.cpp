@@ -37,6 +37,16 @@
 #include "UCTNode.h"
 
 std::atomic<size_t> UCTNodePointer::m_tree_size = {0};
+thread_local std::atomic<size_t>* UCTNodePointer::m_search_tree_size = nullptr;
+
+UCTNodePointer::SearchScope::SearchScope(std::atomic<size_t>& tree_size)
+    : m_previous(m_search_tree_size) {
+    m_search_tree_size = &tree_size;
+}
+
+UCTNodePointer::SearchScope::~SearchScope() {
+    m_search_tree_size = m_previous;
+}
 
 size_t UCTNodePointer::get_tree_size() {
     return m_tree_size.load();
@@ -44,11 +54,18 @@ size_t UCTNodePointer::get_tree_size() {
 
 void UCTNodePointer::increment_tree_size(size_t sz) {
     m_tree_size += sz;
+    if (m_search_tree_size) {
+        *m_search_tree_size += sz;
+    }
 }
 
 void UCTNodePointer::decrement_tree_size(size_t sz) {
     assert(UCTNodePointer::m_tree_size >= sz);
     m_tree_size -= sz;
+    if (m_search_tree_size) {
+        assert(*m_search_tree_size >= sz);
+        *m_search_tree_size -= sz;
+    }
 }
 
 UCTNodePointer::~UCTNodePointer() {
@@ -72,13 +89,17 @@ UCTNodePointer::UCTNodePointer(UCTNodePointer&& n) {
     increment_tree_size(sizeof(UCTNodePointer));
 }
 
-UCTNodePointer::UCTNodePointer(std::int16_t vertex, float policy) {
+std::uint64_t UCTNodePointer::encode(std::int16_t vertex, float policy) {
     std::uint32_t i_policy;
     auto i_vertex = static_cast<std::uint16_t>(vertex);
     std::memcpy(&i_policy, &policy, sizeof(i_policy));
 
-    m_data =  (static_cast<std::uint64_t>(i_policy)  << 32)
-            | (static_cast<std::uint64_t>(i_vertex) << 16);
+    return (static_cast<std::uint64_t>(i_policy)  << 32)
+         | (static_cast<std::uint64_t>(i_vertex) << 16);
+}
+
+UCTNodePointer::UCTNodePointer(std::int16_t vertex, float policy) {
+    m_data = encode(vertex, policy);
     increment_tree_size(sizeof(UCTNodePointer));
 }
 
@@ -119,6 +140,14 @@ void UCTNodePointer::inflate() const {
     }
 }
 
+UCTNode * UCTNodePointer::deflate() {
+    auto v = m_data.load();
+    auto node = read_ptr(v);
+    m_data = encode(node->get_move(), node->get_policy());
+    decrement_tree_size(sizeof(UCTNode));
+    return node;
+}
+
 bool UCTNodePointer::valid() const {
     auto v = m_data.load();
     if (is_inflated(v)) return read_ptr(v)->valid();
@@ -60,6 +60,8 @@ private:
     static constexpr std::uint64_t UNINFLATED = 0;
 
     static std::atomic<size_t> m_tree_size;
+    // Tree size of the search the calling thread works for, if any.
+    static thread_local std::atomic<size_t>* m_search_tree_size;
     static void increment_tree_size(size_t sz);
     static void decrement_tree_size(size_t sz);
 
@@ -95,9 +97,24 @@ private:
         return (v & 3ULL) == POINTER;
     }
 
+    static std::uint64_t encode(std::int16_t vertex, float policy);
+
 public:
     static size_t get_tree_size();
 
+    // While in scope, the tree memory the calling thread creates or
+    // frees is also counted in tree_size. Each search counts its own
+    // tree this way, whichever threads work on it.
+    class SearchScope {
+    public:
+        explicit SearchScope(std::atomic<size_t>& tree_size);
+        ~SearchScope();
+        SearchScope(const SearchScope&) = delete;
+        SearchScope& operator=(const SearchScope&) = delete;
+    private:
+        std::atomic<size_t>* m_previous;
+    };
+
     ~UCTNodePointer();
     UCTNodePointer(UCTNodePointer&& n);
     UCTNodePointer(std::int16_t vertex, float policy);
@@ -124,6 +141,11 @@ public:
     // construct UCTNode instance from the vertex/policy pair
     void inflate() const;
 
+    // opposite of inflate(): store the vertex/policy pair again and hand
+    // the UCTNode instance (and its subtree) to the caller for deletion.
+    // Not thread-safe, nobody else may be using the node.
+    UCTNode * deflate();
+
     // proxy of UCTNode methods which can be called without
     // constructing UCTNode
     bool valid() const;
@@ -205,7 +205,7 @@ void UCTNode::inflate_all_children() {
 
 void UCTNode::prepare_root_node(Network & network, int color,
                                 std::atomic<int>& nodes,
-                                GameState& root_state) {
+                                GameState& root_state, bool add_noise) {
     float root_eval;
     const auto had_children = has_children();
     if (expandable()) {
@@ -227,9 +227,57 @@ void UCTNode::prepare_root_node(Network & network, int color,
     // This also removes a lot of special cases.
     kill_superkos(root_state);
 
-    if (cfg_noise) {
+    if (cfg_noise && add_noise) {
         // Adjust the Dirichlet noise's alpha constant to the board size
         auto alpha = 0.03f * 361.0f / NUM_INTERSECTIONS;
         dirichlet_noise(0.25f, alpha);
     }
 }
+
+// Make this freshly created node a summary of several searches from the
+// same position: the children of the first root, with the statistics of
+// all of them. Nothing below the children is copied. The roots may still
+// be searched, in which case the statistics are approximate.
+void UCTNode::summarize_roots(const std::vector<const UCTNode*>& roots) {
+    assert(m_children.empty());
+    // Children by move, PASS at index 0.
+    auto index = std::vector<int>(FastBoard::NUM_VERTICES + 1, -1);
+    for (const auto& child : roots.front()->m_children) {
+        index[child.get_move() + 1] = m_children.size();
+        m_children.emplace_back(child.get_move(), child.get_policy());
+    }
+    inflate_all_children();
+    for (const auto root : roots) {
+        merge_stats(*root);
+        for (const auto& theirs : root->m_children) {
+            const auto i = index[theirs.get_move() + 1];
+            if (i >= 0 && theirs.is_inflated()) {
+                m_children[i]->merge_stats(*theirs);
+            }
+        }
+    }
+    // The children are all there, so readers may walk them.
+    m_min_psa_ratio_children = roots.front()->m_min_psa_ratio_children.load();
+    m_expand_state = ExpandState::EXPANDED;
+}
+
+void UCTNode::merge_stats(const UCTNode& other) {
+    const auto visits = get_visits();
+    const auto other_visits = other.get_visits();
+    if (other_visits == 0) {
+        return;
+    }
+    if (visits == 0) {
+        m_squared_eval_diff = other.m_squared_eval_diff.load();
+    } else {
+        // Parallel form of Welford's algorithm (Chan et al.).
+        const auto delta = other.get_blackevals() / other_visits
+                         - get_blackevals() / visits;
+        const auto total = double(visits) + double(other_visits);
+        m_squared_eval_diff = static_cast<float>(
+            m_squared_eval_diff + other.m_squared_eval_diff
+            + delta * delta * visits * other_visits / total);
+    }
+    m_visits_vl += std::uint64_t(other_visits);
+    m_blackevals += other.m_blackevals.load();
+}
@@ -34,9 +34,11 @@
 #include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <fstream>
 #include <functional>
 #include <limits>
 #include <memory>
+#include <random>
 #include <type_traits>
 #include <algorithm>
 
@@ -45,7 +47,10 @@
 #include "FullBoard.h"
 #include "GTP.h"
 #include "GameState.h"
+#include "Profiler.h"
+#include "Random.h"
 #include "TimeControl.h"
+#include "Trace.h"
 #include "Timing.h"
 #include "Training.h"
 #include "Utils.h"
@@ -56,62 +61,36 @@
 using namespace Utils;
 
 constexpr int UCTSearch::UNLIMITED_PLAYOUTS;
-
-class OutputAnalysisData {
-public:
-    OutputAnalysisData(const std::string& move, int visits,
-                       float winrate, float policy_prior, std::string pv,
-                       float lcb, bool lcb_ratio_exceeded)
-    : m_move(move), m_visits(visits), m_winrate(winrate),
-      m_policy_prior(policy_prior), m_pv(pv), m_lcb(lcb),
-      m_lcb_ratio_exceeded(lcb_ratio_exceeded) {};
-
-    std::string get_info_string(int order) const {
-        auto tmp = "info move " + m_move
-                 + " visits " + std::to_string(m_visits)
-                 + " winrate "
-                 + std::to_string(static_cast<int>(m_winrate * 10000))
-                 + " prior "
-                 + std::to_string(static_cast<int>(m_policy_prior * 10000.0f))
-                 + " lcb "
-                 + std::to_string(static_cast<int>(std::max(0.0f, m_lcb) * 10000));
-        if (order >= 0) {
-            tmp += " order " + std::to_string(order);
-        }
-        tmp += " pv " + m_pv;
-        return tmp;
-    }
-
-    friend bool operator<(const OutputAnalysisData& a,
-                          const OutputAnalysisData& b) {
-        if (a.m_lcb_ratio_exceeded && b.m_lcb_ratio_exceeded) {
-            if (a.m_lcb != b.m_lcb) {
-                return a.m_lcb < b.m_lcb;
-            }
-        }
-        if (a.m_visits == b.m_visits) {
-            return a.m_winrate < b.m_winrate;
-        }
-        return a.m_visits < b.m_visits;
-    }
-
-private:
-    std::string m_move;
-    int m_visits;
-    float m_winrate;
-    float m_policy_prior;
-    std::string m_pv;
-    float m_lcb;
-    bool m_lcb_ratio_exceeded;
-};
-
+constexpr std::uint32_t UCTSearch::TREE_FILE_MAGIC;
+constexpr std::uint32_t UCTSearch::TREE_FILE_VERSION;
 
 UCTSearch::UCTSearch(GameState& g, Network& network)
     : m_rootstate(g), m_network(network) {
     set_playout_limit(cfg_max_playouts);
     set_visit_limit(cfg_max_visits);
+    set_thread_count(cfg_num_threads);
 
     m_root = std::make_unique<UCTNode>(FastBoard::PASS, 0.0f);
+
+    if (cfg_numa) {
+        m_numa_nodes = get_numa_nodes();
+        if (m_numa_nodes.size() < 2) {
+            myprintf("Only one NUMA node found, searching a single tree.\n");
+            m_numa_nodes.clear();
+        }
+    }
+}
+
+UCTSearch::~UCTSearch() {
+    // Deletion tasks may still be running and refer to us.
+    while (!m_delete_futures.empty()) {
+        m_delete_futures.front().wait_all();
+        m_delete_futures.pop_front();
+    }
+    UCTNodePointer::SearchScope scope(m_tree_size);
+    m_group_roots.clear();
+    m_group_view.reset();
+    m_root.reset();
 }
 
 bool UCTSearch::advance_to_new_rootstate() {
@@ -131,6 +110,12 @@ bool UCTSearch::advance_to_new_rootstate() {
         return false;
     }
 
+    // A speculative ponder sends the root playouts to a few replies by
+    // their priors, so the root children's visits say nothing about
+    // which move is best. Start afresh rather than search on from them.
+    if (depth == 0 && !m_pondered_moves.empty()) {
+        return false;
+    }
 
     auto test = std::make_unique<GameState>(m_rootstate);
     for (auto i = 0; i < depth; i++) {
@@ -156,15 +141,33 @@ bool UCTSearch::advance_to_new_rootstate() {
         test->forward_move();
         const auto move = test->get_last_move();
 
+        if (i == 0 && !m_pondered_moves.empty()) {
+            const auto hit = std::find(begin(m_pondered_moves),
+                                       end(m_pondered_moves), move)
+                             != end(m_pondered_moves);
+            hit ? ++m_ponder_hits : ++m_ponder_misses;
+            myprintf("Reply %s was %spondered (%d of %d hit).\n",
+                     test->move_to_text(move).c_str(), hit ? "" : "not ",
+                     m_ponder_hits, m_ponder_hits + m_ponder_misses);
+        }
+
         auto oldroot = std::move(m_root);
         m_root = oldroot->find_child(move);
 
         // Lazy tree destruction.  Instead of calling the destructor of the
-        // old root node on the main thread, send the old root to a separate
-        // thread and destroy it from the child thread.  This will save a
-        // bit of time when dealing with large trees.
-        auto p = oldroot.release();
-        tg.add_task([p]() { delete p; });
+        // old root node on the main thread, send the old root to separate
+        // threads and destroy it from there.  The subtrees of its children
+        // are split off so they can be destroyed in parallel.  This will
+        // save a bit of time when dealing with large trees.
+        auto subtrees = std::vector<UCTNode*>{oldroot.release()};
+        subtrees.front()->detach_children(subtrees);
+        for (const auto p : subtrees) {
+            tg.add_task([this, p]() {
+                UCTNodePointer::SearchScope scope(m_tree_size);
+                Trace::Span span("delete tree");
+                delete p;
+            });
+        }
         m_delete_futures.push_back(std::move(tg));
 
         if (!m_root) {
@@ -184,23 +187,148 @@ bool UCTSearch::advance_to_new_rootstate() {
     return true;
 }
 
+namespace {
+    // Written field by field in little-endian byte order, so the
+    // layout does not depend on the compiler or the machine.
+    struct TreeFileHeader {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint32_t board_size;
+        float komi;
+        std::uint64_t position_hash;
+        std::uint64_t weights_hash;
+
+        void write(std::ostream& out) const {
+            write_le(out, magic);
+            write_le(out, version);
+            write_le(out, board_size);
+            write_le(out, komi);
+            write_le(out, position_hash);
+            write_le(out, weights_hash);
+        }
+
+        void read(std::istream& in) {
+            magic = read_le<std::uint32_t>(in);
+            version = read_le<std::uint32_t>(in);
+            board_size = read_le<std::uint32_t>(in);
+            komi = read_le<float>(in);
+            position_hash = read_le<std::uint64_t>(in);
+            weights_hash = read_le<std::uint64_t>(in);
+        }
+    };
+}
+
+bool UCTSearch::save_tree(const std::string& filename) {
+    UCTNodePointer::SearchScope scope(m_tree_size);
+    // Bring the tree from the last search up to date with the
+    // current position, as think() would.
+    if (!advance_to_new_rootstate() || !m_root) {
+        myprintf("No search tree for the current position.\n");
+        return false;
+    }
+
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        myprintf("Could not open %s for writing.\n", filename.c_str());
+        return false;
+    }
+
+    auto header = TreeFileHeader{};
+    header.magic = TREE_FILE_MAGIC;
+    header.version = TREE_FILE_VERSION;
+    header.board_size = m_rootstate.board.get_boardsize();
+    header.komi = m_rootstate.get_komi();
+    header.position_hash = m_rootstate.board.get_hash();
+    header.weights_hash = m_network.get_weights_hash();
+    header.write(out);
+
+    m_root->save(out);
+    out.close();
+    if (!out) {
+        myprintf("Error writing %s.\n", filename.c_str());
+        return false;
+    }
+    myprintf("Saved %d visits to %s.\n", m_root->get_visits(),
+             filename.c_str());
+    return true;
+}
+
+bool UCTSearch::load_tree(const std::string& filename) {
+    UCTNodePointer::SearchScope scope(m_tree_size);
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        myprintf("Could not open %s for reading.\n", filename.c_str());
+        return false;
+    }
+
+    auto header = TreeFileHeader{};
+    header.read(in);
+    if (!in || header.magic != TREE_FILE_MAGIC) {
+        myprintf("%s is not a search tree file.\n", filename.c_str());
+        return false;
+    }
+    if (header.version != TREE_FILE_VERSION) {
+        myprintf("Search tree file is the wrong version.\n");
+        return false;
+    }
+    if (header.board_size != std::uint32_t(m_rootstate.board.get_boardsize())
+        || header.komi != m_rootstate.get_komi()
+        || header.position_hash != m_rootstate.board.get_hash()) {
+        myprintf("Search tree is for a different position.\n");
+        return false;
+    }
+    if (header.weights_hash != m_network.get_weights_hash()) {
+        myprintf("Search tree was made with a different network.\n");
+        return false;
+    }
+
+    // Wait for any pending deletions, then read into a fresh root so
+    // that a corrupt file leaves the current tree alone.
+    while (!m_delete_futures.empty()) {
+        m_delete_futures.front().wait_all();
+        m_delete_futures.pop_front();
+    }
+    auto root = std::make_unique<UCTNode>(FastBoard::PASS, 0.0f);
+    if (!root->load(in)) {
+        myprintf("Search tree file is corrupt.\n");
+        return false;
+    }
+
+    m_root = std::move(root);
+    // Let the next search reuse the tree.
+    m_last_rootstate = std::make_unique<GameState>(m_rootstate);
+    m_nodes = m_root->count_nodes_and_clear_expand_state(thread_pool);
+    myprintf("Loaded %d visits, %d nodes from %s.\n", m_root->get_visits(),
+             m_nodes.load(), filename.c_str());
+    return true;
+}
+
 void UCTSearch::update_root() {
+    Trace::Span span("update_root");
+
     // Definition of m_playouts is playouts per search call.
     // So reset this count now.
     m_playouts = 0;
 
 #ifndef NDEBUG
-    auto start_nodes = m_root->count_nodes_and_clear_expand_state();
+    auto start_nodes = m_root->count_nodes_and_clear_expand_state(thread_pool);
 #endif
 
     if (!advance_to_new_rootstate() || !m_root) {
         m_root = std::make_unique<UCTNode>(FastBoard::PASS, 0.0f);
     }
+    m_pondered_moves.clear();
+    m_group_view.reset();
+    m_gc_resume_size = 0;
+    // Every playout copies the root state. Left with a nearly full list
+    // of recent ko hashes, each copy would soon have to fold it into a
+    // copy of the whole history, so fold it once here instead.
+    m_rootstate.fold_ko_hashes();
     // Clear last_rootstate to prevent accidental use.
     m_last_rootstate.reset(nullptr);
 
     // Check how big our search tree (reused or new) is.
-    m_nodes = m_root->count_nodes_and_clear_expand_state();
+    m_nodes = m_root->count_nodes_and_clear_expand_state(thread_pool);
 
 #ifndef NDEBUG
     if (m_nodes > 0) {
@@ -210,8 +338,16 @@ void UCTSearch::update_root() {
 #endif
 }
 
+size_t UCTSearch::max_tree_size() const {
+    return cfg_max_tree_size / m_concurrent_searches;
+}
+
+size_t UCTSearch::get_tree_size() const {
+    return m_tree_size.load();
+}
+
 float UCTSearch::get_min_psa_ratio() const {
-    const auto mem_full = UCTNodePointer::get_tree_size() / static_cast<float>(cfg_max_tree_size);
+    const auto mem_full = m_tree_size / static_cast<float>(max_tree_size());
     // If we are halfway through our memory budget, start trimming
     // moves with very low policy priors.
     if (mem_full > 0.5f) {
@@ -228,8 +364,220 @@ float UCTSearch::get_min_psa_ratio() const {
     return 0.0f;
 }
 
+size_t UCTSearch::live_tree_size() const {
+    // The deletion task updates both counters separately,
+    // so they can briefly be out of step.
+    const auto tree_size = m_tree_size.load();
+    const auto pending = m_gc_pending.load();
+    return tree_size > pending ? tree_size - pending : 0;
+}
+
+bool UCTSearch::tree_needs_collection() const {
+    const auto size = live_tree_size();
+    return size > max_tree_size() * TREE_GC_HIGH_WATER
+        && size > m_gc_resume_size;
+}
+
+void UCTSearch::collect_garbage(ThreadGroup & workers) {
+    Trace::Span span("collect garbage");
+
+    // Stop the workers, as they may be holding pointers into
+    // any of the subtrees we are about to detach.
+    m_run = false;
+    workers.wait_all();
+
+    // Reap the previous collections, they should have finished long ago.
+    while (!m_delete_futures.empty()) {
+        m_delete_futures.front().wait_all();
+        m_delete_futures.pop_front();
+    }
+
+    const auto start_size = live_tree_size();
+    const auto target =
+        static_cast<size_t>(max_tree_size() * TREE_GC_LOW_WATER);
+
+    auto roots = std::vector<UCTNode*>{m_root.get()};
+    for (const auto& root : m_group_roots) {
+        roots.emplace_back(root.get());
+    }
+
+    // When pondering speculatively, give up the replies we are not
+    // pondering before touching the ones we are.
+    auto detached = std::vector<UCTNode*>{};
+    if (!m_ponder_replies.empty()) {
+        for (const auto& child : m_root->get_children()) {
+            if (child.is_inflated()
+                && std::find(begin(m_ponder_replies), end(m_ponder_replies),
+                             child.get()) == end(m_ponder_replies)) {
+                m_gc_pending += child->deflate_children(
+                    std::numeric_limits<int>::max(), detached);
+            }
+        }
+    }
+
+    // Release the least visited subtrees first. One pass tallies how
+    // much memory each power of two visit threshold releases, and the
+    // lowest threshold that gets below the target is used. The children
+    // of the root must stay inflated, so start one level below them.
+    auto memory = std::vector<size_t>(std::numeric_limits<int>::digits + 1);
+    for (const auto root : roots) {
+        for (const auto& child : root->get_children()) {
+            if (child.is_inflated()) {
+                child->tally_memory_by_visits(memory);
+            }
+        }
+    }
+    const auto size = live_tree_size();
+    const auto excess = size > target ? size - target : 0;
+    // Nodes without visits go first, with any threshold.
+    auto released = memory[0];
+    auto min_visits = 1;
+    for (auto bits = size_t{1}; bits < memory.size() && released < excess;
+         bits++) {
+        if ((size_t{1} << bits) > size_t(get_root_visits())) {
+            break;
+        }
+        released += memory[bits];
+        min_visits = 1 << bits;
+    }
+    for (const auto root : roots) {
+        for (const auto& child : root->get_children()) {
+            if (child.is_inflated()) {
+                m_gc_pending += child->deflate_children(min_visits, detached);
+            }
+        }
+    }
+    m_nodes = 0;
+    for (const auto root : roots) {
+        m_nodes += root->count_nodes_and_clear_expand_state(thread_pool);
+    }
+    m_gc_resume_size = live_tree_size()
+        + static_cast<size_t>(max_tree_size() * TREE_GC_MIN_GROWTH);
+
+    myprintf("Tree at %zu MiB, releasing %zu subtrees with < %d visits.\n",
+             start_size / MiB, detached.size(), min_visits);
+
+    // Do the actual deletion in the background, like we do for
+    // the old root in advance_to_new_rootstate.
+    if (!detached.empty()) {
+        ThreadGroup tg(thread_pool);
+        tg.add_task([this, detached]() {
+            UCTNodePointer::SearchScope scope(m_tree_size);
+            Trace::Span span("delete tree", detached.size());
+            for (const auto node : detached) {
+                const auto size = node->get_tree_memory();
+                delete node;
+                m_gc_pending -= size;
+            }
+        });
+        m_delete_futures.push_back(std::move(tg));
+    }
+
+    m_run = true;
+    start_workers(workers);
+}
+
+void UCTSearch::prepare_search_groups(int color, bool add_noise) {
+    const auto groups = std::min(m_numa_nodes.size(), m_num_threads);
+    for (auto i = size_t{1}; i < groups; i++) {
+        auto root = std::make_unique<UCTNode>(FastBoard::PASS, 0.0f);
+        root->prepare_root_node(m_network, color, m_nodes, m_rootstate,
+                                add_noise);
+        m_group_roots.emplace_back(std::move(root));
+    }
+}
+
+// Summarize the groups for the move choice and the output, and free
+// the trees of all but the first. Their statistics are not merged into
+// m_root, whose subtrees would not match them once it is reused or saved.
+void UCTSearch::merge_search_groups() {
+    m_group_view.reset();
+    if (m_group_roots.empty()) {
+        return;
+    }
+    Trace::Span span("merge groups");
+    update_group_view();
+    ThreadGroup tg(thread_pool);
+    for (auto& root : m_group_roots) {
+        auto p = root.release();
+        tg.add_task([this, p]() {
+            UCTNodePointer::SearchScope scope(m_tree_size);
+            Trace::Span span("delete tree");
+            delete p;
+        });
+    }
+    m_delete_futures.push_back(std::move(tg));
+    m_group_roots.clear();
+}
+
+void UCTSearch::update_group_view() {
+    auto roots = std::vector<const UCTNode*>{m_root.get()};
+    for (const auto& root : m_group_roots) {
+        roots.emplace_back(root.get());
+    }
+    m_group_view = std::make_unique<UCTNode>(FastBoard::PASS, 0.0f);
+    m_group_view->summarize_roots(roots);
+}
+
+// The root to base decisions and output on while searching: the group
+// view if there are several groups.
+UCTNode& UCTSearch::get_summary_root() {
+    return m_group_view ? *m_group_view : *m_root;
+}
+
+// The group view only has the root children, so variations below
+// them are followed in the tree of the first group.
+UCTNode& UCTSearch::get_pv_node(const UCTNode& parent, UCTNode& child) {
+    if (&parent == m_group_view.get()) {
+        for (const auto& node : m_root->get_children()) {
+            if (node.is_inflated() && node.get_move() == child.get_move()) {
+                return *node;
+            }
+        }
+    }
+    return child;
+}
+
+// Start the helper threads of the search. In NUMA mode they are spread
+// round robin over the search groups and bound to the group's node,
+// the calling thread always searches m_root.
+void UCTSearch::start_workers(ThreadGroup & workers) {
+    const auto groups = m_group_roots.size() + 1;
+    for (auto i = size_t{1}; i < m_num_threads; i++) {
+        const auto group = i % groups;
+        if (group == 0) {
+            workers.add_task(UCTWorker(m_rootstate, this, m_root.get(),
+                                       m_numa_nodes.empty()
+                                           ? std::vector<int>{}
+                                           : m_numa_nodes[0]));
+        } else {
+            workers.add_task(UCTWorker(m_rootstate, this,
+                                       m_group_roots[group - 1].get(),
+                                       m_numa_nodes[group]));
+        }
+    }
+}
+
+int UCTSearch::get_playouts() const {
+    return m_playouts.load();
+}
+
+int UCTSearch::get_nodes() const {
+    return m_nodes.load();
+}
+
+int UCTSearch::get_root_visits() const {
+    auto visits = m_root->get_visits();
+    for (const auto& root : m_group_roots) {
+        visits += root->get_visits();
+    }
+    return visits;
+}
+
 SearchResult UCTSearch::play_simulation(GameState & currstate,
                                         UCTNode* const node) {
+    PROFILE_PHASE(PLAYOUT);
+
     const auto color = currstate.get_to_move();
     auto result = SearchResult{};
 
@@ -252,7 +600,13 @@ SearchResult UCTSearch::play_simulation(GameState & currstate,
     }
 
     if (node->has_children() && !result.valid()) {
-        auto next = node->uct_select_child(color, node == m_root.get());
+        auto next = static_cast<UCTNode*>(nullptr);
+        if (node == m_root.get() && !m_ponder_replies.empty()) {
+            next = select_ponder_reply();
+        }
+        if (!next) {
+            next = node->uct_select_child(color, node == m_root.get());
+        }
         auto move = next->get_move();
 
         currstate.play_move(move);
@@ -299,7 +653,7 @@ void UCTSearch::dump_stats(FastState & state, UCTNode & parent) {
         auto move = state.move_to_text(node->get_move());
         auto tmpstate = FastState{state};
         tmpstate.play_move(node->get_move());
-        auto pv = move + " " + get_pv(tmpstate, *node);
+        auto pv = move + " " + get_pv(tmpstate, get_pv_node(parent, *node));
 
         myprintf("%4s -> %7d (V: %5.2f%%) (LCB: %5.2f%%) (N: %5.2f%%) PV: %s\n",
             move.c_str(),
@@ -309,17 +663,35 @@ void UCTSearch::dump_stats(FastState & state, UCTNode & parent) {
             node->get_policy() * 100.0f,
             pv.c_str());
     }
-    tree_stats(parent);
+    // The group view has no tree below its children.
+    tree_stats(&parent == m_group_view.get() ? *m_root : parent);
 }
 
 void UCTSearch::output_analysis(FastState & state, UCTNode & parent) {
-    // We need to make a copy of the data before sorting
-    auto sortable_data = std::vector<OutputAnalysisData>();
-
     if (!parent.has_children()) {
         return;
     }
 
+    auto sortable_data = get_analysis_data(state, parent,
+                                           cfg_analyze_tags.post_move_count());
+
+    auto i = 0;
+    // Output analysis data in gtp stream
+    for (const auto& node : sortable_data) {
+        if (i > 0) {
+            gtp_printf_raw(" ");
+        }
+        gtp_printf_raw(node.get_info_string(i).c_str());
+        i++;
+    }
+    gtp_printf_raw("\n");
+}
+
+std::vector<OutputAnalysisData> UCTSearch::get_analysis_data(
+    FastState & state, UCTNode & parent, size_t min_moves) {
+    // We need to make a copy of the data before sorting
+    auto sortable_data = std::vector<OutputAnalysisData>();
+
     const auto color = state.get_to_move();
 
     auto max_visits = 0;
@@ -331,13 +703,13 @@ void UCTSearch::output_analysis(FastState & state, UCTNode & parent) {
         // Send only variations with visits, unless more moves were
         // requested explicitly.
         if (!node->get_visits()
-            && sortable_data.size() >= cfg_analyze_tags.post_move_count()) {
+            && sortable_data.size() >= min_moves) {
             continue;
         }
         auto move = state.move_to_text(node->get_move());
         auto tmpstate = FastState{state};
         tmpstate.play_move(node->get_move());
-        auto rest_of_pv = get_pv(tmpstate, *node);
+        auto rest_of_pv = get_pv(tmpstate, get_pv_node(parent, *node));
         auto pv = move + (rest_of_pv.empty() ? "" : " " + rest_of_pv);
         auto move_eval = node->get_visits() ? node->get_raw_eval(color) : 0.0f;
         auto policy = node->get_policy();
@@ -352,17 +724,7 @@ void UCTSearch::output_analysis(FastState & state, UCTNode & parent) {
     }
     // Sort array to decide order
     std::stable_sort(rbegin(sortable_data), rend(sortable_data));
-
-    auto i = 0;
-    // Output analysis data in gtp stream
-    for (const auto& node : sortable_data) {
-        if (i > 0) {
-            gtp_printf_raw(" ");
-        }
-        gtp_printf_raw(node.get_info_string(i).c_str());
-        i++;
-    }
-    gtp_printf_raw("\n");
+    return sortable_data;
 }
 
 void UCTSearch::tree_stats(const UCTNode& node) {
@@ -457,23 +819,24 @@ bool UCTSearch::should_resign(passflag_t passflag, float besteval) {
 
 int UCTSearch::get_best_move(passflag_t passflag) {
     int color = m_rootstate.board.get_to_move();
+    auto& root = get_summary_root();
 
     auto max_visits = 0;
-    for (const auto& node : m_root->get_children()) {
+    for (const auto& node : root.get_children()) {
         max_visits = std::max(max_visits, node->get_visits());
     }
 
     // Make sure best is first
-    m_root->sort_children(color,  cfg_lcb_min_visit_ratio * max_visits);
+    root.sort_children(color,  cfg_lcb_min_visit_ratio * max_visits);
 
     // Check whether to randomize the best move proportional
     // to the playout counts, early game only.
     auto movenum = int(m_rootstate.get_movenum());
     if (movenum < cfg_random_cnt) {
-        m_root->randomize_first_proportionally();
+        root.randomize_first_proportionally();
     }
 
-    auto first_child = m_root->get_first_child();
+    auto first_child = root.get_first_child();
     assert(first_child != nullptr);
 
     auto bestmove = first_child->get_move();
@@ -483,7 +846,7 @@ int UCTSearch::get_best_move(passflag_t passflag) {
     if (passflag & UCTSearch::NOPASS) {
         // were we going to pass?
         if (bestmove == FastBoard::PASS) {
-            UCTNode * nopass = m_root->get_nopass_child(m_rootstate);
+            UCTNode * nopass = root.get_nopass_child(m_rootstate);
 
             if (nopass != nullptr) {
                 myprintf("Preferring not to pass.\n");
@@ -524,7 +887,7 @@ int UCTSearch::get_best_move(passflag_t passflag) {
             if (relative_score < 0.0f) {
                 myprintf("Passing loses :-(\n");
                 // Find a valid non-pass move.
-                UCTNode * nopass = m_root->get_nopass_child(m_rootstate);
+                UCTNode * nopass = root.get_nopass_child(m_rootstate);
                 if (nopass != nullptr) {
                     myprintf("Avoiding pass because it loses.\n");
                     bestmove = nopass->get_move();
@@ -541,7 +904,7 @@ int UCTSearch::get_best_move(passflag_t passflag) {
             } else {
                 myprintf("Passing draws :-|\n");
                 // Find a valid non-pass move.
-                const auto nopass = m_root->get_nopass_child(m_rootstate);
+                const auto nopass = root.get_nopass_child(m_rootstate);
                 if (nopass != nullptr && !nopass->first_visit()) {
                     const auto nopass_eval = nopass->get_raw_eval(color);
                     if (nopass_eval > 0.5f) {
@@ -610,7 +973,7 @@ std::string UCTSearch::get_pv(FastState & state, UCTNode& parent) {
 
     state.play_move(best_move);
 
-    auto next = get_pv(state, best_child);
+    auto next = get_pv(state, get_pv_node(parent, best_child));
     if (!next.empty()) {
         res.append(" ").append(next);
     }
@@ -621,40 +984,179 @@ std::string UCTSearch::get_analysis(int playouts) {
     FastState tempstate = m_rootstate;
     int color = tempstate.board.get_to_move();
 
-    auto pvstring = get_pv(tempstate, *m_root);
-    float winrate = 100.0f * m_root->get_raw_eval(color);
+    auto& root = get_summary_root();
+    auto pvstring = get_pv(tempstate, root);
+    float winrate = 100.0f * root.get_raw_eval(color);
     return str(boost::format("Playouts: %d, Win: %5.2f%%, PV: %s")
         % playouts % winrate % pvstring.c_str());
 }
 
 bool UCTSearch::is_running() const {
-    return m_run && UCTNodePointer::get_tree_size() < cfg_max_tree_size;
+    return m_run && m_tree_size < max_tree_size();
 }
 
 int UCTSearch::est_playouts_left(int elapsed_centis, int time_for_move) const {
     auto playouts = m_playouts.load();
     const auto playouts_left =
         std::max(0, std::min(m_maxplayouts - playouts,
-                             m_maxvisits - m_root->get_visits()));
+                             m_maxvisits - get_root_visits()));
 
     // Wait for at least 1 second and 100 playouts
-    // so we get a reliable playout_rate.
-    if (elapsed_centis < 100 || playouts < 100) {
+    // so we get a reliable playout_rate. Until then, adaptive time
+    // management falls back to the rate of the previous searches.
+    auto playout_rate = 0.0f;
+    if (elapsed_centis >= 100 && playouts >= 100) {
+        playout_rate = 1.0f * playouts / elapsed_centis;
+    } else if (cfg_timemanage == TimeManagement::ADAPTIVE) {
+        playout_rate = m_playout_rate;
+    }
+    if (playout_rate <= 0.0f) {
         return playouts_left;
     }
-    const auto playout_rate = 1.0f * playouts / elapsed_centis;
     const auto time_left = std::max(0, time_for_move - elapsed_centis);
     return std::min(playouts_left,
                     static_cast<int>(std::ceil(playout_rate * time_left)));
 }
 
+void UCTSearch::update_playout_rate(int elapsed_centis) {
+    const auto playouts = m_playouts.load();
+    if (elapsed_centis < 100 || playouts < 100) {
+        return;
+    }
+    const auto playout_rate = 1.0f * playouts / elapsed_centis;
+    if (m_playout_rate <= 0.0f) {
+        m_playout_rate = playout_rate;
+    } else {
+        m_playout_rate += PLAYOUT_RATE_DECAY * (playout_rate - m_playout_rate);
+    }
+}
+
+int UCTSearch::adaptive_time_for_move(int color, int time_for_move) const {
+    const auto& tc = m_rootstate.get_timecontrol();
+    // Extending only pays off if the time is taken from moves that
+    // turn out to be easy, and the opening is played fast anyway.
+    if (!tc.can_accumulate_time(color)
+        || m_rootstate.get_movenum()
+           < tc.opening_moves(m_rootstate.board.get_boardsize())) {
+        return time_for_move;
+    }
+    return static_cast<int>(time_for_move * ADAPTIVE_MAX_EXTENSION);
+}
+
+bool UCTSearch::root_is_stable(int elapsed_centis) {
+    auto best_move = int{FastBoard::PASS};
+    auto best_visits = 0;
+    auto total_visits = 0;
+    for (const auto& node : get_summary_root().get_children()) {
+        const auto visits = node.get_visits();
+        if (visits > best_visits) {
+            best_visits = visits;
+            best_move = node.get_move();
+        }
+        total_visits += visits;
+    }
+    if (best_move != m_stable_move) {
+        m_stable_move = best_move;
+        m_stable_since = elapsed_centis;
+        return false;
+    }
+    // Ask for as many playouts as the regular pruning does before
+    // trusting the visit distribution.
+    if (m_playouts < 100 || total_visits == 0) {
+        return false;
+    }
+    const auto share = 1.0f * best_visits / total_visits;
+    const auto stable_for = elapsed_centis - m_stable_since;
+    return share >= ADAPTIVE_STABLE_SHARE
+        && stable_for >= ADAPTIVE_STABLE_FRACTION * elapsed_centis;
+}
+
+// Pick the opponent replies to ponder on: the ones the network
+// expects most, since only the reply actually played is any use.
+void UCTSearch::select_ponder_replies() {
+    m_ponder_replies.clear();
+    for (const auto& child : m_root->get_children()) {
+        if (child.valid()) {
+            m_ponder_replies.emplace_back(child.get());
+        }
+    }
+    const auto replies = std::min(m_ponder_replies.size(),
+                                  size_t{PONDER_REPLIES});
+    std::partial_sort(begin(m_ponder_replies),
+                      begin(m_ponder_replies) + replies,
+                      end(m_ponder_replies),
+                      [](const UCTNode* a, const UCTNode* b) {
+                          return a->get_policy() > b->get_policy();
+                      });
+    m_ponder_replies.resize(replies);
+
+    m_pondered_moves.clear();
+    for (const auto node : m_ponder_replies) {
+        m_pondered_moves.emplace_back(node->get_move());
+    }
+}
+
+// Spread the playouts over the pondered replies in proportion to
+// their policy priors, by visiting the one furthest behind its share.
+UCTNode* UCTSearch::select_ponder_reply() const {
+    auto best = static_cast<UCTNode*>(nullptr);
+    auto best_value = std::numeric_limits<double>::lowest();
+    for (const auto node : m_ponder_replies) {
+        if (!node->active()) {
+            continue;
+        }
+        const auto value = node->get_policy() / (1.0 + node->get_visits());
+        if (value > best_value) {
+            best_value = value;
+            best = node;
+        }
+    }
+    return best;
+}
+
+bool UCTSearch::root_distribution_converged() {
+    const auto& children = get_summary_root().get_children();
+    auto visits = std::vector<int>(children.size());
+    auto total = 0;
+    for (auto i = size_t{0}; i < children.size(); i++) {
+        visits[i] = children[i].get_visits();
+        total += visits[i];
+    }
+    if (total - m_kld_total < KLDGAIN_INTERVAL) {
+        return false;
+    }
+    auto converged = false;
+    if (m_kld_total > 0 && m_kld_visits.size() == visits.size()) {
+        // KL(new || old). A move that got its first visits since the
+        // last sample makes this infinite, so keep searching.
+        auto kld = 0.0;
+        for (auto i = size_t{0}; i < visits.size(); i++) {
+            if (visits[i] == 0) {
+                continue;
+            }
+            if (m_kld_visits[i] == 0) {
+                kld = std::numeric_limits<double>::infinity();
+                break;
+            }
+            const auto p = 1.0 * visits[i] / total;
+            const auto q = 1.0 * m_kld_visits[i] / m_kld_total;
+            kld += p * std::log(p / q);
+        }
+        converged = kld / (total - m_kld_total) < cfg_kldgain;
+    }
+    m_kld_visits = std::move(visits);
+    m_kld_total = total;
+    return converged;
+}
+
 size_t UCTSearch::prune_noncontenders(int color, int elapsed_centis, int time_for_move, bool prune) {
     auto lcb_max = 0.0f;
     auto Nfirst = 0;
+    auto& root = get_summary_root();
     // There are no cases where the root's children vector gets modified
     // during a multithreaded search, so it is safe to walk it here without
     // taking the (root) node lock.
-    for (const auto& node : m_root->get_children()) {
+    for (const auto& node : root.get_children()) {
         if (node->valid()) {
             const auto visits = node->get_visits();
             if (visits > 0) {
@@ -666,7 +1168,9 @@ size_t UCTSearch::prune_noncontenders(int color, int elapsed_centis, int time_fo
     const auto min_required_visits =
         Nfirst - est_playouts_left(elapsed_centis, time_for_move);
     auto pruned_nodes = size_t{0};
-    for (const auto& node : m_root->get_children()) {
+    // Whether each move stays active, PASS at index 0.
+    auto active = std::vector<char>(FastBoard::NUM_VERTICES + 1, true);
+    for (const auto& node : root.get_children()) {
         if (node->valid()) {
             const auto visits = node->get_visits();
             const auto has_enough_visits =
@@ -677,16 +1181,26 @@ size_t UCTSearch::prune_noncontenders(int color, int elapsed_centis, int time_fo
                 node->get_raw_eval(color) >= lcb_max : false;
             const auto prune_this_node = !(has_enough_visits || high_winrate);
 
-            if (prune) {
-                node->set_active(!prune_this_node);
-            }
+            active[node->get_move() + 1] = !prune_this_node;
             if (prune_this_node) {
                 ++pruned_nodes;
             }
         }
     }
+    // Every group searches its own copy of the root children.
+    if (prune) {
+        auto roots = std::vector<UCTNode*>{m_root.get()};
+        for (const auto& group_root : m_group_roots) {
+            roots.emplace_back(group_root.get());
+        }
+        for (const auto group_root : roots) {
+            for (const auto& node : group_root->get_children()) {
+                node->set_active(active[node->get_move() + 1]);
+            }
+        }
+    }
 
-    assert(pruned_nodes < m_root->get_children().size());
+    assert(pruned_nodes < root.get_children().size());
     return pruned_nodes;
 }
 
@@ -726,18 +1240,154 @@ bool UCTSearch::have_alternate_moves(int elapsed_centis, int time_for_move) {
 
 bool UCTSearch::stop_thinking(int elapsed_centis, int time_for_move) const {
     return m_playouts >= m_maxplayouts
-           || m_root->get_visits() >= m_maxvisits
+           || get_root_visits() >= m_maxvisits
            || elapsed_centis >= time_for_move;
 }
 
+// Every playout works on its own copy of the root position.
+static std::unique_ptr<GameState> copy_root_state(const GameState& state) {
+    PROFILE_PHASE(STATE_COPY);
+    return std::make_unique<GameState>(state);
+}
+
+namespace {
+    // One playout of a lock-step round.
+    struct LockstepPlayout {
+        std::unique_ptr<GameState> state;
+        // Nodes from the root down, all holding a virtual loss.
+        std::vector<UCTNode*> path;
+        // Node to expand with the network output, if any.
+        UCTNode* leaf{nullptr};
+        int symmetry{Network::IDENTITY_SYMMETRY};
+        Network::Netresult netresult;
+        SearchResult result;
+    };
+}
+
+// Deterministic search. Each round, cfg_lockstep virtual threads pick
+// their leaves one after the other, with virtual losses, as if they
+// were searching in parallel. The leaves are then evaluated as one
+// batch by the real threads, and backed up in the same fixed order.
+// Symmetries come from a random stream per virtual thread, and the NN
+// cache is bypassed, so the tree does not depend on thread timing.
+// Partially expanded nodes are not expanded any further.
+void UCTSearch::search_lockstep(const Time& start, int time_for_move) {
+    const auto workers = size_t(cfg_lockstep);
+    auto rngs = std::vector<Random>{};
+    for (auto i = size_t{0}; i < workers; i++) {
+        rngs.emplace_back(cfg_rng_seed + i);
+    }
+    auto playouts = std::vector<LockstepPlayout>(workers);
+    auto leaves = std::vector<UCTNode*>{};
+
+    auto keeprunning = true;
+    do {
+        Trace::Span span("lockstep round");
+        const auto min_psa_ratio = get_min_psa_ratio();
+        leaves.clear();
+
+        for (auto i = size_t{0}; i < workers; i++) {
+            auto& playout = playouts[i];
+            playout.state = copy_root_state(m_rootstate);
+            playout.path.clear();
+            playout.leaf = nullptr;
+            playout.result = SearchResult{};
+
+            auto node = m_root.get();
+            for (;;) {
+                node->virtual_loss();
+                playout.path.emplace_back(node);
+                if (node->has_children()) {
+                    const auto color = playout.state->get_to_move();
+                    const auto next =
+                        node->uct_select_child(color, node == m_root.get());
+                    const auto move = next->get_move();
+                    playout.state->play_move(move);
+                    if (move != FastBoard::PASS
+                        && playout.state->superko()) {
+                        next->invalidate();
+                        break;
+                    }
+                    node = next;
+                } else {
+                    if (playout.state->get_passes() >= 2) {
+                        const auto score = playout.state->final_score();
+                        playout.result = SearchResult::from_score(score);
+                    } else if (node->expandable(min_psa_ratio)
+                               && std::find(begin(leaves), end(leaves), node)
+                                  == end(leaves)) {
+                        // A leaf another virtual thread already picked
+                        // this round is a collision, as in a real search.
+                        leaves.emplace_back(node);
+                        playout.leaf = node;
+                        playout.symmetry =
+                            rngs[i].randfix<Network::NUM_SYMMETRIES>();
+                    }
+                    break;
+                }
+            }
+        }
+
+        ThreadGroup tg(thread_pool);
+        for (auto t = size_t{0}; t < m_num_threads; t++) {
+            tg.add_task([this, t, &playouts]() {
+                for (auto i = t; i < playouts.size(); i += m_num_threads) {
+                    auto& playout = playouts[i];
+                    if (playout.leaf) {
+                        playout.netresult = m_network.get_output(
+                            playout.state.get(), Network::Ensemble::DIRECT,
+                            playout.symmetry, false, false);
+                    }
+                }
+            });
+        }
+        tg.wait_all();
+
+        for (auto& playout : playouts) {
+            auto result = playout.result;
+            auto eval = 0.0f;
+            if (playout.leaf
+                && playout.leaf->create_children(playout.netresult, m_nodes,
+                                                 *playout.state, eval,
+                                                 min_psa_ratio)) {
+                result = SearchResult::from_eval(eval);
+            }
+            for (auto it = rbegin(playout.path); it != rend(playout.path);
+                 ++it) {
+                if (result.valid()) {
+                    (*it)->update(result.eval());
+                }
+                (*it)->virtual_loss_undo();
+            }
+            if (result.valid()) {
+                increment_playouts();
+            }
+        }
+
+        Time elapsed;
+        const auto elapsed_centis = Time::timediff_centis(start, elapsed);
+        keeprunning  = is_running();
+        keeprunning &= !stop_thinking(elapsed_centis, time_for_move);
+    } while (keeprunning);
+}
+
 void UCTWorker::operator()() {
+    UCTNodePointer::SearchScope scope(m_search->m_tree_size);
+    auto previous_cpus = std::vector<int>{};
+    if (!m_cpus.empty()) {
+        previous_cpus = bind_thread_to_cpus(m_cpus);
+    }
     do {
-        auto currstate = std::make_unique<GameState>(m_rootstate);
+        auto currstate = copy_root_state(m_rootstate);
         auto result = m_search->play_simulation(*currstate, m_root);
         if (result.valid()) {
             m_search->increment_playouts();
         }
     } while (m_search->is_running());
+    // The thread belongs to the shared pool, so give it back unbound.
+    if (!previous_cpus.empty()) {
+        bind_thread_to_cpus(previous_cpus);
+    }
 }
 
 void UCTSearch::increment_playouts() {
@@ -745,6 +1395,8 @@ void UCTSearch::increment_playouts() {
 }
 
 int UCTSearch::think(int color, passflag_t passflag) {
+    UCTNodePointer::SearchScope scope(m_tree_size);
+
     // Start counting time for us
     m_rootstate.start_clock(color);
 
@@ -760,24 +1412,60 @@ int UCTSearch::think(int color, passflag_t passflag) {
             m_rootstate.board.get_boardsize(),
             color, m_rootstate.get_movenum());
 
-    myprintf("Thinking at most %.1f seconds...\n", time_for_move/100.0f);
+    // With adaptive time management, time_for_move is the time we
+    // expect to use, and max_time_for_move bounds the extensions for
+    // positions where the best move keeps changing.
+    const auto adaptive = cfg_timemanage == TimeManagement::ADAPTIVE
+        && m_rootstate.get_timecontrol().can_accumulate_time(color);
+    auto max_time_for_move = time_for_move;
+    if (adaptive) {
+        max_time_for_move = adaptive_time_for_move(color, time_for_move);
+    }
+    m_stable_move = FastBoard::PASS;
+    m_stable_since = 0;
+    m_kld_visits.clear();
+    m_kld_total = 0;
+
+    // Playout cap randomization: search a share of the moves with a
+    // small budget. They keep the game going but are too shallow to
+    // be used as training targets.
+    const auto fast_search = cfg_fast_visits > 0
+        && std::uniform_real_distribution<float>{0.0f, 1.0f}(
+               Random::get_Rng()) < cfg_fast_prob;
+    const auto full_maxvisits = m_maxvisits;
+    if (fast_search) {
+        m_maxvisits = std::min(m_maxvisits, cfg_fast_visits);
+        myprintf("Fast search, at most %d visits.\n", m_maxvisits);
+    }
+
+    myprintf("Thinking at most %.1f seconds...\n", max_time_for_move/100.0f);
+
+#ifdef USE_PROFILER
+    Profiler::reset();
+#endif
 
     // create a sorted list of legal moves (make sure we
     // play something legal and decent even in time trouble)
-    m_root->prepare_root_node(m_network, color, m_nodes, m_rootstate);
+    // Fast searches are not training targets, so they get no noise.
+    m_root->prepare_root_node(m_network, color, m_nodes, m_rootstate,
+                              !fast_search);
 
     m_run = true;
-    int cpus = cfg_num_threads;
     ThreadGroup tg(thread_pool);
-    for (int i = 1; i < cpus; i++) {
-        tg.add_task(UCTWorker(m_rootstate, this, m_root.get()));
+    auto keeprunning = true;
+    if (cfg_lockstep > 0) {
+        search_lockstep(start, time_for_move);
+        keeprunning = false;
+    } else {
+        prepare_search_groups(color, !fast_search);
+        start_workers(tg);
     }
 
-    auto keeprunning = true;
     auto last_update = 0;
     auto last_output = 0;
-    do {
-        auto currstate = std::make_unique<GameState>(m_rootstate);
+    auto last_view = -1;
+    while (keeprunning) {
+        auto currstate = copy_root_state(m_rootstate);
 
         auto result = play_simulation(*currstate, m_root.get());
         if (result.valid()) {
@@ -787,10 +1475,17 @@ int UCTSearch::think(int color, passflag_t passflag) {
         Time elapsed;
         int elapsed_centis = Time::timediff_centis(start, elapsed);
 
+        // Let time management and output see all the search groups,
+        // rebuilding their view at most once per centisecond.
+        if (!m_group_roots.empty() && elapsed_centis > last_view) {
+            last_view = elapsed_centis;
+            update_group_view();
+        }
+
         if (cfg_analyze_tags.interval_centis() &&
             elapsed_centis - last_output > cfg_analyze_tags.interval_centis()) {
             last_output = elapsed_centis;
-            output_analysis(m_rootstate, *m_root);
+            output_analysis(m_rootstate, get_summary_root());
         }
 
         // output some stats every few seconds
@@ -799,19 +1494,38 @@ int UCTSearch::think(int color, passflag_t passflag) {
             last_update = elapsed_centis;
             myprintf("%s\n", get_analysis(m_playouts.load()).c_str());
         }
+        if (tree_needs_collection()) {
+            collect_garbage(tg);
+        }
         keeprunning  = is_running();
-        keeprunning &= !stop_thinking(elapsed_centis, time_for_move);
-        keeprunning &= have_alternate_moves(elapsed_centis, time_for_move);
-    } while (keeprunning);
+        keeprunning &= !stop_thinking(elapsed_centis, max_time_for_move);
+        keeprunning &= have_alternate_moves(elapsed_centis, max_time_for_move);
+        if (keeprunning && adaptive && root_is_stable(elapsed_centis)
+            && elapsed_centis >= ADAPTIVE_SOFT_FRACTION * time_for_move) {
+            if (max_time_for_move - elapsed_centis > 50) {
+                myprintf("Best move is stable, %.1fs left, stopping early.\n",
+                         (max_time_for_move - elapsed_centis) / 100.0f);
+            }
+            keeprunning = false;
+        }
+        if (keeprunning && cfg_kldgain > 0.0f
+            && get_root_visits() >= cfg_kldgain_min_visits
+            && root_distribution_converged()) {
+            myprintf("Root visits converged, stopping early.\n");
+            keeprunning = false;
+        }
+    }
 
     // Make sure to post at least once.
     if (cfg_analyze_tags.interval_centis() && last_output == 0) {
-        output_analysis(m_rootstate, *m_root);
+        output_analysis(m_rootstate, get_summary_root());
     }
 
     // Stop the search.
     m_run = false;
     tg.wait_all();
+    merge_search_groups();
+    m_maxvisits = full_maxvisits;
 
     // Reactivate all pruned root children.
     for (const auto& node : m_root->get_children()) {
@@ -825,17 +1539,25 @@ int UCTSearch::think(int color, passflag_t passflag) {
 
     // Display search info.
     myprintf("\n");
-    dump_stats(m_rootstate, *m_root);
-    Training::record(m_network, m_rootstate, *m_root);
+    auto& root = get_summary_root();
+    dump_stats(m_rootstate, root);
+    if (!fast_search) {
+        Training::record(m_network, m_rootstate, root);
+    }
 
     Time elapsed;
     int elapsed_centis = Time::timediff_centis(start, elapsed);
+    update_playout_rate(elapsed_centis);
     myprintf("%d visits, %d nodes, %d playouts, %.0f n/s\n\n",
-             m_root->get_visits(),
+             root.get_visits(),
              m_nodes.load(),
              m_playouts.load(),
              (m_playouts * 100.0) / (elapsed_centis+1));
 
+#ifdef USE_PROFILER
+    myprintf("%s\n", Profiler::get_report().c_str());
+#endif
+
 #ifdef USE_OPENCL
 #ifndef NDEBUG
     myprintf("batch stats: %d %d\n",
@@ -853,7 +1575,7 @@ int UCTSearch::think(int color, passflag_t passflag) {
         % m_rootstate.get_movenum()
         % (color == FastBoard::BLACK ? 'B' : 'W')
         % m_rootstate.move_to_text(bestmove).c_str()
-        % get_analysis(m_root->get_visits()).c_str());
+        % get_analysis(root.get_visits()).c_str());
 
     // Copy the root state. Use to check for tree re-use in future calls.
     m_last_rootstate = std::make_unique<GameState>(m_rootstate);
@@ -865,7 +1587,9 @@ std::string UCTSearch::explain_last_think() const {
     return m_think_output;
 }
 
-void UCTSearch::ponder() {
+void UCTSearch::ponder(bool speculative) {
+    UCTNodePointer::SearchScope scope(m_tree_size);
+
     auto disable_reuse = cfg_analyze_tags.has_move_restrictions();
     if (disable_reuse) {
         m_last_rootstate.reset(nullptr);
@@ -875,17 +1599,25 @@ void UCTSearch::ponder() {
 
     m_root->prepare_root_node(m_network, m_rootstate.board.get_to_move(),
                               m_nodes, m_rootstate);
+    prepare_search_groups(m_rootstate.board.get_to_move());
+    if (speculative && !disable_reuse) {
+        select_ponder_replies();
+        auto replies = std::string{};
+        for (const auto move : m_pondered_moves) {
+            replies += " " + m_rootstate.move_to_text(move);
+        }
+        myprintf("Pondering on replies%s.\n", replies.c_str());
+    }
 
     m_run = true;
     ThreadGroup tg(thread_pool);
-    for (auto i = size_t{1}; i < cfg_num_threads; i++) {
-        tg.add_task(UCTWorker(m_rootstate, this, m_root.get()));
-    }
+    start_workers(tg);
     Time start;
     auto keeprunning = true;
     auto last_output = 0;
+    auto last_view = -1;
     do {
-        auto currstate = std::make_unique<GameState>(m_rootstate);
+        auto currstate = copy_root_state(m_rootstate);
         auto result = play_simulation(*currstate, m_root.get());
         if (result.valid()) {
             increment_playouts();
@@ -893,29 +1625,39 @@ void UCTSearch::ponder() {
         if (cfg_analyze_tags.interval_centis()) {
             Time elapsed;
             int elapsed_centis = Time::timediff_centis(start, elapsed);
+            if (!m_group_roots.empty() && elapsed_centis > last_view) {
+                last_view = elapsed_centis;
+                update_group_view();
+            }
             if (elapsed_centis - last_output > cfg_analyze_tags.interval_centis()) {
                 last_output = elapsed_centis;
-                output_analysis(m_rootstate, *m_root);
+                output_analysis(m_rootstate, get_summary_root());
             }
         }
+        if (tree_needs_collection()) {
+            collect_garbage(tg);
+        }
         keeprunning  = is_running();
         keeprunning &= !stop_thinking(0, 1);
     } while (!Utils::input_pending() && keeprunning);
 
     // Make sure to post at least once.
     if (cfg_analyze_tags.interval_centis() && last_output == 0) {
-        output_analysis(m_rootstate, *m_root);
+        output_analysis(m_rootstate, get_summary_root());
     }
 
     // Stop the search.
     m_run = false;
     tg.wait_all();
+    merge_search_groups();
+    m_ponder_replies.clear();
 
     // Display search info.
     myprintf("\n");
-    dump_stats(m_rootstate, *m_root);
+    auto& root = get_summary_root();
+    dump_stats(m_rootstate, root);
 
-    myprintf("\n%d visits, %d nodes\n\n", m_root->get_visits(), m_nodes.load());
+    myprintf("\n%d visits, %d nodes\n\n", root.get_visits(), m_nodes.load());
 
     // Copy the root state. Use to check for tree re-use in future calls.
     if (!disable_reuse) {
@@ -923,6 +1665,58 @@ void UCTSearch::ponder() {
     }
 }
 
+// Search the current position until the root has the given number of
+// visits and return the analysis of the root moves. Unlike think() and
+// ponder() this does no time management, output or training, so several
+// searches can analyze different positions at the same time. The tree
+// is kept for reuse by the next call.
+AnalysisResult UCTSearch::analyze(int visits) {
+    UCTNodePointer::SearchScope scope(m_tree_size);
+
+    update_root();
+
+    const auto color = m_rootstate.board.get_to_move();
+    m_root->prepare_root_node(m_network, color, m_nodes, m_rootstate);
+
+    auto result = AnalysisResult{};
+    if (m_root->has_children()) {
+        prepare_search_groups(color);
+
+        m_run = true;
+        ThreadGroup tg(thread_pool);
+        start_workers(tg);
+        do {
+            auto currstate = copy_root_state(m_rootstate);
+            auto simulation = play_simulation(*currstate, m_root.get());
+            if (simulation.valid()) {
+                increment_playouts();
+            }
+            if (tree_needs_collection()) {
+                collect_garbage(tg);
+            }
+        } while (is_running() && get_root_visits() < visits);
+
+        m_run = false;
+        tg.wait_all();
+        merge_search_groups();
+
+        result.moves = get_analysis_data(m_rootstate, get_summary_root(), 0);
+    }
+    result.visits = get_summary_root().get_visits();
+
+    // Copy the root state. Use to check for tree re-use in future calls.
+    m_last_rootstate = std::make_unique<GameState>(m_rootstate);
+    return result;
+}
+
+void UCTSearch::set_thread_count(size_t threads) {
+    m_num_threads = std::max(threads, size_t{1});
+}
+
+void UCTSearch::set_concurrent_searches(size_t searches) {
+    m_concurrent_searches = std::max(searches, size_t{1});
+}
+
 void UCTSearch::set_playout_limit(int playouts) {
     static_assert(std::is_convertible<decltype(playouts),
                                       decltype(m_maxplayouts)>::value,
@@ -31,11 +31,13 @@
 #define UCTSEARCH_H_INCLUDED
 
 #include <list>
+#include <algorithm>
 #include <atomic>
 #include <memory>
 #include <string>
 #include <tuple>
 #include <future>
+#include <vector>
 
 #include "ThreadPool.h"
 #include "FastBoard.h"
@@ -43,6 +45,7 @@
 #include "GameState.h"
 #include "UCTNode.h"
 #include "Network.h"
+#include "Timing.h"
 
 
 class SearchResult {
@@ -69,9 +72,81 @@ private:
     float m_eval{0.0f};
 };
 
+class OutputAnalysisData {
+public:
+    OutputAnalysisData(const std::string& move, int visits,
+                       float winrate, float policy_prior, std::string pv,
+                       float lcb, bool lcb_ratio_exceeded)
+    : m_move(move), m_visits(visits), m_winrate(winrate),
+      m_policy_prior(policy_prior), m_pv(pv), m_lcb(lcb),
+      m_lcb_ratio_exceeded(lcb_ratio_exceeded) {};
+
+    std::string get_info_string(int order) const {
+        auto tmp = "info move " + m_move
+                 + " visits " + std::to_string(m_visits)
+                 + " winrate "
+                 + std::to_string(static_cast<int>(m_winrate * 10000))
+                 + " prior "
+                 + std::to_string(static_cast<int>(m_policy_prior * 10000.0f))
+                 + " lcb "
+                 + std::to_string(static_cast<int>(std::max(0.0f, m_lcb) * 10000));
+        if (order >= 0) {
+            tmp += " order " + std::to_string(order);
+        }
+        tmp += " pv " + m_pv;
+        return tmp;
+    }
+
+    std::string get_json_string() const {
+        return "{\"move\":\"" + m_move + "\""
+             + ",\"visits\":" + std::to_string(m_visits)
+             + ",\"winrate\":" + std::to_string(m_winrate)
+             + ",\"prior\":" + std::to_string(m_policy_prior)
+             + ",\"lcb\":" + std::to_string(std::max(0.0f, m_lcb))
+             + ",\"pv\":\"" + m_pv + "\"}";
+    }
+
+    const std::string& get_move() const { return m_move; }
+    int get_visits() const { return m_visits; }
+    float get_winrate() const { return m_winrate; }
+    float get_policy_prior() const { return m_policy_prior; }
+    const std::string& get_pv() const { return m_pv; }
+    float get_lcb() const { return m_lcb; }
+
+    friend bool operator<(const OutputAnalysisData& a,
+                          const OutputAnalysisData& b) {
+        if (a.m_lcb_ratio_exceeded && b.m_lcb_ratio_exceeded) {
+            if (a.m_lcb != b.m_lcb) {
+                return a.m_lcb < b.m_lcb;
+            }
+        }
+        if (a.m_visits == b.m_visits) {
+            return a.m_winrate < b.m_winrate;
+        }
+        return a.m_visits < b.m_visits;
+    }
+
+private:
+    std::string m_move;
+    int m_visits;
+    float m_winrate;
+    float m_policy_prior;
+    std::string m_pv;
+    float m_lcb;
+    bool m_lcb_ratio_exceeded;
+};
+
+// Result of UCTSearch::analyze.
+struct AnalysisResult {
+    // Visits of the root when the search stopped.
+    int visits{0};
+    // Candidate moves, best first.
+    std::vector<OutputAnalysisData> moves;
+};
+
 namespace TimeManagement {
     enum enabled_t {
-        AUTO = -1, OFF = 0, ON = 1, FAST = 2, NO_PRUNING = 3
+        AUTO = -1, OFF = 0, ON = 1, FAST = 2, NO_PRUNING = 3, ADAPTIVE = 4
     };
 };
 
@@ -99,6 +174,21 @@ public:
     */
     static constexpr size_t MIN_TREE_SPACE = 100'000'000;
 
+    /*
+        When the search tree grows past this fraction of the maximum
+        tree size, low-visit subtrees are released until it is back
+        down to the second fraction.
+    */
+    static constexpr auto TREE_GC_HIGH_WATER = 0.90f;
+    static constexpr auto TREE_GC_LOW_WATER = 0.70f;
+    /*
+        After a collection, the tree must grow by this fraction of the
+        maximum tree size before the next one. If the subtrees cannot be
+        released, the search stops at the maximum tree size instead of
+        collecting after every playout.
+    */
+    static constexpr auto TREE_GC_MIN_GROWTH = 0.05f;
+
     /*
         Value representing unlimited visits or playouts. Due to
         concurrent updates while multithreading, we need some
@@ -107,17 +197,70 @@ public:
     static constexpr auto UNLIMITED_PLAYOUTS =
         std::numeric_limits<int>::max() / 2;
 
+    /*
+        Identification of the files written by save_tree. Bump the
+        version whenever the layout written by UCTNode::save changes.
+    */
+    static constexpr std::uint32_t TREE_FILE_MAGIC = 0x5254'5a4c; // "LZTR"
+    static constexpr std::uint32_t TREE_FILE_VERSION = 1;
+
+    /*
+        Adaptive time management. A search whose best move has held
+        ADAPTIVE_STABLE_SHARE of the root visits for the last
+        ADAPTIVE_STABLE_FRACTION of the search may stop after
+        ADAPTIVE_SOFT_FRACTION of its time. An unstable one may run
+        for up to ADAPTIVE_MAX_EXTENSION times its time.
+    */
+    static constexpr auto ADAPTIVE_STABLE_SHARE = 0.5f;
+    static constexpr auto ADAPTIVE_STABLE_FRACTION = 0.4f;
+    static constexpr auto ADAPTIVE_SOFT_FRACTION = 0.4f;
+    static constexpr auto ADAPTIVE_MAX_EXTENSION = 1.6f;
+
+    /*
+        Number of likely opponent replies that pondering after our
+        own move spreads its playouts over.
+    */
+    static constexpr auto PONDER_REPLIES = 4;
+
+    /*
+        Visits between the samples of the root visit distribution
+        compared by the --kldgain stopping rule.
+    */
+    static constexpr auto KLDGAIN_INTERVAL = 100;
+
+    /*
+        Weight of the latest search in the running playout rate.
+    */
+    static constexpr auto PLAYOUT_RATE_DECAY = 0.3f;
+
     UCTSearch(GameState& g, Network & network);
+    ~UCTSearch();
     int think(int color, passflag_t passflag = NORMAL);
     void set_playout_limit(int playouts);
     void set_visit_limit(int visits);
-    void ponder();
+    void ponder(bool speculative = false);
+    AnalysisResult analyze(int visits);
+    void set_thread_count(size_t threads);
+    // Searches running side by side each get 1/searches of the
+    // maximum tree size.
+    void set_concurrent_searches(size_t searches);
+    // Memory held by this search's tree, see UCTNodePointer.
+    size_t get_tree_size() const;
     bool is_running() const;
     void increment_playouts();
+    // Playouts of the last search and nodes of its tree.
+    int get_playouts() const;
+    int get_nodes() const;
     std::string explain_last_think() const;
+    bool save_tree(const std::string& filename);
+    bool load_tree(const std::string& filename);
     SearchResult play_simulation(GameState& currstate, UCTNode* const node);
 
 private:
+    friend class UCTWorker;
+    friend class LeelaTest;
+
+    size_t max_tree_size() const;
     float get_min_psa_ratio() const;
     void dump_stats(FastState& state, UCTNode& parent);
     void tree_stats(const UCTNode& node);
@@ -126,6 +269,12 @@ private:
     bool should_resign(passflag_t passflag, float besteval);
     bool have_alternate_moves(int elapsed_centis, int time_for_move);
     int est_playouts_left(int elapsed_centis, int time_for_move) const;
+    void update_playout_rate(int elapsed_centis);
+    int adaptive_time_for_move(int color, int time_for_move) const;
+    bool root_is_stable(int elapsed_centis);
+    bool root_distribution_converged();
+    void select_ponder_replies();
+    UCTNode* select_ponder_reply() const;
     size_t prune_noncontenders(int color, int elapsed_centis = 0, int time_for_move = 0,
                                bool prune = true);
     bool stop_thinking(int elapsed_centis = 0, int time_for_move = 0) const;
@@ -133,6 +282,20 @@ private:
     void update_root();
     bool advance_to_new_rootstate();
     void output_analysis(FastState & state, UCTNode & parent);
+    std::vector<OutputAnalysisData> get_analysis_data(FastState & state,
+                                                      UCTNode & parent,
+                                                      size_t min_moves);
+    size_t live_tree_size() const;
+    bool tree_needs_collection() const;
+    void collect_garbage(Utils::ThreadGroup & workers);
+    void prepare_search_groups(int color, bool add_noise = true);
+    void merge_search_groups();
+    void update_group_view();
+    UCTNode& get_summary_root();
+    UCTNode& get_pv_node(const UCTNode& parent, UCTNode& child);
+    void start_workers(Utils::ThreadGroup & workers);
+    void search_lockstep(const Time& start, int time_for_move);
+    int get_root_visits() const;
 
     GameState & m_rootstate;
     std::unique_ptr<GameState> m_last_rootstate;
@@ -144,20 +307,62 @@ private:
     int m_maxvisits;
     std::string m_think_output;
 
+    // Tree memory of this search, and its share of cfg_max_tree_size.
+    std::atomic<size_t> m_tree_size{0};
+    size_t m_concurrent_searches{1};
+
     std::list<Utils::ThreadGroup> m_delete_futures;
+    // Tree memory detached by collect_garbage() but not yet deleted.
+    std::atomic<size_t> m_gc_pending{0};
+    // Live tree size below which no new collection starts.
+    size_t m_gc_resume_size{0};
+
+    // In NUMA mode, the CPUs of each node and the roots of the extra
+    // search trees for the nodes after the first. These trees only
+    // live for one search and are merged into m_root at its end.
+    std::vector<std::vector<int>> m_numa_nodes;
+    std::vector<std::unique_ptr<UCTNode>> m_group_roots;
+    // Root children with the statistics of all groups, rebuilt during
+    // the search for time management and analysis output.
+    std::unique_ptr<UCTNode> m_group_view;
+
+    // Playouts per centisecond over the previous searches,
+    // zero until one has run long enough to measure it.
+    float m_playout_rate{0.0f};
+    // Best root move of the running search and since when it has been.
+    int m_stable_move{FastBoard::PASS};
+    int m_stable_since{0};
+    // Root child visits at the last --kldgain sample, and their sum.
+    std::vector<int> m_kld_visits;
+    int m_kld_total{0};
+
+    // While pondering speculatively, the root children for the
+    // opponent replies we search. The moves of the last set are kept
+    // to see whether the opponent played one of them.
+    std::vector<UCTNode*> m_ponder_replies;
+    std::vector<int> m_pondered_moves;
+    int m_ponder_hits{0};
+    int m_ponder_misses{0};
+
+    // Threads per search, including the calling one.
+    size_t m_num_threads;
 
     Network & m_network;
 };
 
 class UCTWorker {
 public:
-    UCTWorker(GameState & state, UCTSearch * search, UCTNode * root)
-      : m_rootstate(state), m_search(search), m_root(root) {}
+    UCTWorker(GameState & state, UCTSearch * search, UCTNode * root,
+              std::vector<int> cpus = {})
+      : m_rootstate(state), m_search(search), m_root(root),
+        m_cpus(std::move(cpus)) {}
     void operator()();
 private:
     GameState & m_rootstate;
     UCTSearch * m_search;
     UCTNode * m_root;
+    // CPUs to run on, empty to run anywhere.
+    std::vector<int> m_cpus;
 };
 
 #endif
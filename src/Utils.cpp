@@ -33,6 +33,8 @@
 #include <mutex>
 #include <cstdarg>
 #include <cstdio>
+#include <fstream>
+#include <sstream>
 
 #include <boost/filesystem.hpp>
 #include <boost/math/distributions/students_t.hpp>
@@ -45,6 +47,10 @@
 #include <sys/types.h>
 #include <pwd.h>
 #endif
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 #include "GTP.h"
 
@@ -232,3 +238,59 @@ const std::string Utils::leelaz_file(std::string file) {
     dir /= file;
     return dir.string();
 }
+
+std::vector<std::vector<int>> Utils::get_numa_nodes() {
+    auto nodes = std::vector<std::vector<int>>{};
+#ifdef __linux__
+    // Nodes are numbered consecutively, each lists its CPUs
+    // in a format like "0-15,32-47".
+    for (auto node = 0; ; node++) {
+        std::ifstream cpulist("/sys/devices/system/node/node"
+                              + std::to_string(node) + "/cpulist");
+        auto line = std::string{};
+        if (!std::getline(cpulist, line)) {
+            break;
+        }
+        auto cpus = std::vector<int>{};
+        auto ranges = std::istringstream{line};
+        auto range = std::string{};
+        while (std::getline(ranges, range, ',')) {
+            auto first = 0, last = 0;
+            auto dash = char{};
+            auto rs = std::istringstream{range};
+            rs >> first;
+            last = (rs >> dash >> last) ? last : first;
+            for (auto cpu = first; cpu <= last; cpu++) {
+                cpus.emplace_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            nodes.emplace_back(std::move(cpus));
+        }
+    }
+#endif
+    return nodes;
+}
+
+std::vector<int> Utils::bind_thread_to_cpus(const std::vector<int>& cpus) {
+    auto previous = std::vector<int>{};
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+        for (auto cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) {
+                previous.emplace_back(cpu);
+            }
+        }
+    }
+    CPU_ZERO(&set);
+    for (const auto cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpus;
+#endif
+    return previous;
+}
@@ -33,8 +33,14 @@
 #include "config.h"
 
 #include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <istream>
 #include <limits>
+#include <ostream>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 #include "ThreadPool.h"
 
@@ -60,6 +66,46 @@ namespace Utils {
         return (x << k) | (x >> (std::numeric_limits<T>::digits - k));
     }
 
+    template<size_t Size> struct uint_of_size;
+    template<> struct uint_of_size<1> { using type = std::uint8_t; };
+    template<> struct uint_of_size<2> { using type = std::uint16_t; };
+    template<> struct uint_of_size<4> { using type = std::uint32_t; };
+    template<> struct uint_of_size<8> { using type = std::uint64_t; };
+
+    // Binary I/O of numbers as fixed-width little-endian values, so
+    // the files can be read on any machine.
+    template<typename T>
+    void write_le(std::ostream& out, const T value) {
+        static_assert(std::is_integral<T>::value
+                      || std::numeric_limits<T>::is_iec559,
+                      "Only integers and IEEE floats can be written");
+        typename uint_of_size<sizeof(T)>::type bits;
+        std::memcpy(&bits, &value, sizeof(T));
+        char bytes[sizeof(T)];
+        for (auto i = size_t{0}; i < sizeof(T); i++) {
+            bytes[i] = static_cast<char>(bits >> (8 * i));
+        }
+        out.write(bytes, sizeof(T));
+    }
+
+    template<typename T>
+    T read_le(std::istream& in) {
+        static_assert(std::is_integral<T>::value
+                      || std::numeric_limits<T>::is_iec559,
+                      "Only integers and IEEE floats can be read");
+        using uint_t = typename uint_of_size<sizeof(T)>::type;
+        unsigned char bytes[sizeof(T)] = {};
+        in.read(reinterpret_cast<char*>(bytes), sizeof(T));
+        auto bits = uint_t{0};
+        for (auto i = size_t{0}; i < sizeof(T); i++) {
+            bits |= static_cast<uint_t>(static_cast<uint_t>(bytes[i])
+                                        << (8 * i));
+        }
+        auto value = T{};
+        std::memcpy(&value, &bits, sizeof(T));
+        return value;
+    }
+
     inline bool is7bit(int c) {
         return c >= 0 && c <= 127;
     }
@@ -70,6 +116,12 @@ namespace Utils {
 
     void create_z_table();
     float cached_t_quantile(int v);
+
+    // CPUs of each NUMA node. Empty if the topology is unknown.
+    std::vector<std::vector<int>> get_numa_nodes();
+    // Restrict the calling thread to the given CPUs, if supported.
+    // Returns the CPUs it could run on before, empty if unknown.
+    std::vector<int> bind_thread_to_cpus(const std::vector<int>& cpus);
 }
 
 #endif
@@ -0,0 +1,371 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+/*
+    leelaz-bench: search a fixed corpus of positions at a fixed number
+    of visits for every combination of thread count and batch size
+    given, and print the speed and resource use of each as JSON, so
+    that runs before and after a change can be compared.
+*/
+
+#include "config.h"
+
+#include <algorithm>
+#include <atomic>
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "GTP.h"
+#include "GameState.h"
+#include "Network.h"
+#include "Random.h"
+#include "ThreadPool.h"
+#include "Timing.h"
+#include "UCTSearch.h"
+#include "Utils.h"
+#include "Zobrist.h"
+
+using namespace Utils;
+
+namespace {
+
+struct BenchPosition {
+    std::string name;
+    // Moves from the empty board, black first.
+    std::string moves;
+    // Seeded random moves played after them, to fill the board.
+    int random_moves;
+};
+
+const auto CORPUS = std::vector<BenchPosition>{
+    {"opening", "q16 d4 c16", 0},
+    {"fighting",
+     "q16 d4 q4 d16 c3 d3 c4 c5 b5 c6 d2 e2 c2 e3 f17 c14 r10 k16 "
+     "k17 j17 l16 k15 l15 k14 l14 k13 r14 c17 c18 d17", 0},
+    {"endgame", "q16 d4 q4 d16", 220},
+    // White to move, and may not retake the ko at k10 yet.
+    {"ko", "q16 d4 q4 d16 k11 l11 j10 k10 k9 l9 c3 m10 l10", 0},
+};
+
+// Seed for the random part of the corpus, so it never changes.
+constexpr auto CORPUS_SEED = std::uint64_t{5489};
+
+struct SearchSample {
+    std::string position;
+    int playouts;
+    int nodes;
+    double seconds;
+    size_t peak_tree_bytes;
+};
+
+void setup_position(GameState& game, const BenchPosition& position) {
+    game.init_game(BOARD_SIZE, KOMI);
+    game.set_timecontrol(0, 1, 0, 0);  // Set infinite time.
+
+    auto moves = std::istringstream{position.moves};
+    auto move = std::string{};
+    while (moves >> move) {
+        const auto color =
+            game.get_to_move() == FastBoard::BLACK ? "b" : "w";
+        if (!game.play_textmove(color, move)) {
+            throw std::runtime_error("Illegal move " + move
+                                     + " in position " + position.name);
+        }
+    }
+
+    auto rng = Random{CORPUS_SEED};
+    for (auto i = 0; i < position.random_moves; i++) {
+        const auto color = game.get_to_move();
+        auto candidates = std::vector<int>{};
+        for (auto y = 0; y < BOARD_SIZE; y++) {
+            for (auto x = 0; x < BOARD_SIZE; x++) {
+                const auto vertex = game.board.get_vertex(x, y);
+                if (game.is_move_legal(color, vertex)
+                    && !game.board.is_eye(color, vertex)) {
+                    candidates.emplace_back(vertex);
+                }
+            }
+        }
+        if (candidates.empty()) {
+            break;
+        }
+        game.play_move(candidates[rng.randuint64(candidates.size())]);
+    }
+}
+
+// Nearest-rank percentile of sorted values.
+double percentile(const std::vector<double>& sorted, double p) {
+    const auto rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::max(rank, size_t{1}) - 1];
+}
+
+std::string json_number(double x) {
+    return str(boost::format("%.3f") % x);
+}
+
+std::string run_config(const std::string& weightsfile, int visits,
+                       unsigned int threads, unsigned int batch_size,
+                       int repeat) {
+    cfg_num_threads = threads;
+    cfg_batch_size = batch_size;
+
+    // A fresh network for every run, so the cache starts out empty
+    // and the batch size takes effect.
+    auto network = std::make_unique<Network>();
+    network->initialize(visits, weightsfile);
+
+    auto samples = std::vector<SearchSample>{};
+    for (auto r = 0; r < repeat; r++) {
+        for (const auto& position : CORPUS) {
+            auto game = GameState{};
+            setup_position(game, position);
+
+            auto search = std::make_unique<UCTSearch>(game, *network);
+            // Sample the tree size of the search every millisecond,
+            // so the tree itself does not have to track its peak.
+            auto peak_tree_bytes = size_t{0};
+            std::atomic<bool> searching{true};
+            auto sampler = std::thread([&]() {
+                while (searching) {
+                    peak_tree_bytes = std::max(peak_tree_bytes,
+                                               search->get_tree_size());
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            });
+            const auto start = Time{};
+            search->think(game.get_to_move(), UCTSearch::NORESIGN);
+            const auto seconds = Time::timediff_seconds(start, Time{});
+            searching = false;
+            sampler.join();
+            peak_tree_bytes = std::max(peak_tree_bytes,
+                                       search->get_tree_size());
+
+            samples.push_back({position.name,
+                               search->get_playouts(),
+                               search->get_nodes(),
+                               seconds,
+                               peak_tree_bytes});
+            myprintf_error("threads %u batch %u %s: %d playouts, %.2fs\n",
+                           threads, batch_size, position.name.c_str(),
+                           samples.back().playouts, seconds);
+        }
+    }
+
+    auto playouts = 0.0;
+    auto nodes = 0.0;
+    auto seconds = 0.0;
+    auto peak_tree_bytes = size_t{0};
+    auto latencies = std::vector<double>{};
+    for (const auto& sample : samples) {
+        playouts += sample.playouts;
+        nodes += sample.nodes;
+        seconds += sample.seconds;
+        peak_tree_bytes = std::max(peak_tree_bytes, sample.peak_tree_bytes);
+        latencies.emplace_back(1000.0 * sample.seconds);
+    }
+    std::sort(begin(latencies), end(latencies));
+
+    const auto hits = network->get_cache_hit_rate();
+    const auto cache_hit_rate =
+        hits.second > 0 ? double(hits.first) / hits.second : 0.0;
+    // Pipes that evaluate one position at a time have no batches.
+    const auto batches = network->get_batch_stats();
+    const auto batch_fill = batches.batches == 0 ? std::string{"null"}
+        : json_number(double(batches.positions)
+                      / (batches.batches * batch_size));
+
+    auto out = std::ostringstream{};
+    out << "    {\"threads\": " << threads
+        << ", \"batch_size\": " << batch_size
+        << ", \"searches\": " << samples.size()
+        << ", \"seconds\": " << json_number(seconds) << ",\n"
+        << "     \"playouts_per_second\": "
+        << json_number(playouts / seconds)
+        << ", \"nodes_per_second\": " << json_number(nodes / seconds)
+        << ", \"batch_fill\": " << batch_fill
+        << ", \"cache_hit_rate\": " << json_number(cache_hit_rate)
+        << ", \"peak_tree_bytes\": " << peak_tree_bytes << ",\n"
+        << "     \"latency_ms\": {\"p50\": "
+        << json_number(percentile(latencies, 0.50))
+        << ", \"p90\": " << json_number(percentile(latencies, 0.90))
+        << ", \"p99\": " << json_number(percentile(latencies, 0.99))
+        << ", \"max\": " << json_number(latencies.back()) << "},\n"
+        << "     \"positions\": [";
+    for (auto i = size_t{0}; i < samples.size(); i++) {
+        const auto& sample = samples[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << "       {\"name\": \"" << sample.position << "\""
+            << ", \"playouts\": " << sample.playouts
+            << ", \"nodes\": " << sample.nodes
+            << ", \"ms\": " << json_number(1000.0 * sample.seconds) << "}";
+    }
+    out << "]}";
+    return out.str();
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    namespace po = boost::program_options;
+
+    GTP::setup_default_parameters();
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "Show commandline options.")
+        ("weights,w", po::value<std::string>()->default_value(cfg_weightsfile),
+                      "File with network weights.")
+        ("visits,v", po::value<int>()->default_value(800),
+                     "Visits per search.")
+        ("threads,t",
+            po::value<std::vector<unsigned int>>()->multitoken()
+                ->default_value({1}, "1"),
+            "Thread counts to run with.")
+#ifdef USE_OPENCL
+        ("batchsize",
+            po::value<std::vector<unsigned int>>()->multitoken()
+                ->default_value({1}, "1"),
+            "OpenCL batch sizes to run with.")
+        ("gpu", po::value<std::vector<int>>(),
+                "ID of the OpenCL device(s) to use (disables autodetection).")
+#endif
+#ifndef USE_CPU_ONLY
+        ("cpu-only", "Use CPU-only implementation and do not use OpenCL device(s).")
+#endif
+        ("repeat,r", po::value<int>()->default_value(1),
+                     "Times to search every position.")
+        ("seed,s", po::value<std::uint64_t>()->default_value(0),
+                   "Random number generation seed.")
+        ("output,o", po::value<std::string>(),
+                     "Write the report to this file instead of stdout.")
+        ;
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+    } catch (const boost::program_options::error& e) {
+        printf("ERROR: %s\n", e.what());
+        std::cout << desc << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    const auto weightsfile = vm["weights"].as<std::string>();
+    const auto visits = vm["visits"].as<int>();
+    const auto repeat = vm["repeat"].as<int>();
+    const auto thread_counts = vm["threads"].as<std::vector<unsigned int>>();
+    auto batch_sizes = std::vector<unsigned int>{1};
+#ifdef USE_OPENCL
+    batch_sizes = vm["batchsize"].as<std::vector<unsigned int>>();
+    if (vm.count("gpu")) {
+        cfg_gpus = vm["gpu"].as<std::vector<int>>();
+    }
+#endif
+#ifndef USE_CPU_ONLY
+    if (vm.count("cpu-only")) {
+        cfg_cpu_only = true;
+    }
+    if (cfg_cpu_only) {
+        batch_sizes = {1};
+    }
+#endif
+    if (visits < 1 || repeat < 1) {
+        printf("Visits and repeat must be at least 1.\n");
+        return EXIT_FAILURE;
+    }
+    for (const auto threads : thread_counts) {
+        if (threads < 1 || threads > MAX_CPUS) {
+            printf("Thread counts must be between 1 and %d.\n", MAX_CPUS);
+            return EXIT_FAILURE;
+        }
+    }
+
+    cfg_quiet = true;
+    cfg_allow_pondering = false;
+    cfg_timemanage = TimeManagement::OFF;
+    cfg_max_visits = visits;
+    cfg_rng_seed = vm["seed"].as<std::uint64_t>();
+
+    thread_pool.initialize(
+        *std::max_element(begin(thread_counts), end(thread_counts)));
+    auto rng = std::make_unique<Random>(5489);
+    Zobrist::init_zobrist(*rng);
+    Random::get_Rng().seedrandom(cfg_rng_seed);
+    Utils::create_z_table();
+
+    auto runs = std::vector<std::string>{};
+    try {
+        for (const auto batch_size : batch_sizes) {
+            for (const auto threads : thread_counts) {
+                runs.emplace_back(run_config(weightsfile, visits, threads,
+                                             batch_size, repeat));
+            }
+        }
+    } catch (const std::exception& e) {
+        printf("ERROR: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    auto report = std::ostringstream{};
+    report << "{\"weights\": \"" << weightsfile << "\""
+           << ", \"visits\": " << visits
+           << ", \"repeat\": " << repeat
+           << ", \"runs\": [\n";
+    for (auto i = size_t{0}; i < runs.size(); i++) {
+        report << runs[i] << (i + 1 < runs.size() ? ",\n" : "\n");
+    }
+    report << "]}\n";
+
+    if (vm.count("output")) {
+        auto file = std::ofstream{vm["output"].as<std::string>()};
+        if (!(file << report.str())) {
+            printf("ERROR: could not write %s\n",
+                   vm["output"].as<std::string>().c_str());
+            return EXIT_FAILURE;
+        }
+    } else {
+        std::cout << report.str();
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,300 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+/*
+    board-bench: play seeded random games and time the board and state
+    operations the search relies on over all their positions, in
+    nanoseconds per call, so that changes to them can be measured.
+*/
+
+#include "config.h"
+
+#include <algorithm>
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "FullBoard.h"
+#include "GTP.h"
+#include "GameState.h"
+#include "Network.h"
+#include "Random.h"
+#include "RandomGame.h"
+#include "Zobrist.h"
+
+namespace {
+
+struct Corpus {
+    // Every position of every game, and the moves of each game.
+    std::vector<GameState> positions;
+    std::vector<std::vector<int>> games;
+};
+
+Corpus play_games(int games, std::uint64_t seed) {
+    auto corpus = Corpus{};
+    auto rng = Random{seed};
+    for (auto i = 0; i < games; i++) {
+        auto game = GameState{};
+        game.init_game(BOARD_SIZE, KOMI);
+        corpus.positions.emplace_back(game);
+        auto moves = std::vector<int>{};
+        play_random_game(game, rng, RandomGameOptions{},
+                         [&](const GameState&, int, int move) {
+            corpus.positions.emplace_back(game);
+            moves.emplace_back(move);
+            return true;
+        });
+        corpus.games.emplace_back(std::move(moves));
+    }
+    return corpus;
+}
+
+struct OpResult {
+    std::string name;
+    size_t calls;
+    double ns_per_op;
+};
+
+// Run op repeat times, calling prepare untimed before each run, and
+// return the fastest run. op returns the number of calls it made.
+OpResult time_op(const std::string& name, int repeat,
+                 const std::function<void()>& prepare,
+                 const std::function<size_t()>& op) {
+    auto result = OpResult{name, 0, std::numeric_limits<double>::max()};
+    for (auto i = 0; i < repeat; i++) {
+        prepare();
+        const auto start = std::chrono::steady_clock::now();
+        result.calls = op();
+        const auto elapsed = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count();
+        result.ns_per_op = std::min(result.ns_per_op, elapsed / result.calls);
+    }
+    return result;
+}
+
+std::vector<OpResult> run_ops(const Corpus& corpus, int repeat,
+                              std::uint64_t& checksum) {
+    const auto& positions = corpus.positions;
+    const auto nothing = [] {};
+    auto results = std::vector<OpResult>{};
+
+    auto boards = std::vector<GameBoard>{};
+    results.emplace_back(time_op("update_board", repeat,
+        [&] {
+            boards.assign(corpus.games.size(), GameBoard{});
+            for (auto& board : boards) {
+                board.reset_board(BOARD_SIZE);
+            }
+        },
+        [&] {
+            auto calls = size_t{0};
+            for (auto i = size_t{0}; i < corpus.games.size(); i++) {
+                auto color = int{FastBoard::BLACK};
+                for (const auto move : corpus.games[i]) {
+                    checksum += boards[i].update_board(color, move);
+                    color = !color;
+                    calls++;
+                }
+            }
+            return calls;
+        }));
+
+    results.emplace_back(time_op("is_suicide", repeat, nothing, [&] {
+        auto calls = size_t{0};
+        for (const auto& state : positions) {
+            const auto& board = state.board;
+            for (auto y = 0; y < BOARD_SIZE; y++) {
+                for (auto x = 0; x < BOARD_SIZE; x++) {
+                    const auto vertex = board.get_vertex(x, y);
+                    if (board.get_state(vertex) == FastBoard::EMPTY) {
+                        checksum += board.is_suicide(vertex,
+                                                     state.get_to_move());
+                        calls++;
+                    }
+                }
+            }
+        }
+        return calls;
+    }));
+
+    results.emplace_back(time_op("superko", repeat, nothing, [&] {
+        for (const auto& state : positions) {
+            checksum += state.superko();
+        }
+        return positions.size();
+    }));
+
+    results.emplace_back(time_op("calc_hash", repeat, nothing, [&] {
+        for (const auto& state : positions) {
+            checksum += state.board.calc_hash(state.m_komove);
+        }
+        return positions.size();
+    }));
+
+    results.emplace_back(time_op("calc_symmetry_hash", repeat, nothing, [&] {
+        for (const auto& state : positions) {
+            for (auto s = 1; s < Network::NUM_SYMMETRIES; s++) {
+                checksum += state.board.calc_symmetry_hash(state.m_komove, s);
+            }
+        }
+        return positions.size() * (Network::NUM_SYMMETRIES - 1);
+    }));
+
+    results.emplace_back(time_op("get_symmetry_hash", repeat, nothing, [&] {
+        for (const auto& state : positions) {
+            for (auto s = 1; s < Network::NUM_SYMMETRIES; s++) {
+                checksum += state.get_symmetry_hash(s);
+            }
+        }
+        return positions.size() * (Network::NUM_SYMMETRIES - 1);
+    }));
+
+    results.emplace_back(time_op("area_score", repeat, nothing, [&] {
+        for (const auto& state : positions) {
+            checksum += static_cast<int>(2 * state.board.area_score(KOMI));
+        }
+        return positions.size();
+    }));
+
+    results.emplace_back(time_op("gamestate_copy", repeat, nothing, [&] {
+        for (const auto& state : positions) {
+            const auto copy = GameState{state};
+            checksum += copy.board.get_hash();
+        }
+        return positions.size();
+    }));
+
+    results.emplace_back(time_op("gather_features", repeat, nothing, [&] {
+        for (const auto& state : positions) {
+            const auto features = Network::gather_features(&state, 0);
+            checksum += features.size() + int(features.back());
+        }
+        return positions.size();
+    }));
+
+    return results;
+}
+
+std::string json_number(double x) {
+    return str(boost::format("%.3f") % x);
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    namespace po = boost::program_options;
+
+    GTP::setup_default_parameters();
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "Show commandline options.")
+        ("games,g", po::value<int>()->default_value(10),
+                    "Random games to play.")
+        ("repeat,r", po::value<int>()->default_value(5),
+                     "Times to run every operation, the fastest run counts.")
+        ("seed,s", po::value<std::uint64_t>()->default_value(1),
+                   "Seed for the random games.")
+        ("output,o", po::value<std::string>(),
+                     "Write the report to this file instead of stdout.")
+        ;
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+    } catch (const boost::program_options::error& e) {
+        printf("ERROR: %s\n", e.what());
+        std::cout << desc << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    const auto games = vm["games"].as<int>();
+    const auto repeat = vm["repeat"].as<int>();
+    if (games < 1 || repeat < 1) {
+        printf("Games and repeat must be at least 1.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Fixed Zobrist keys, so the checksum only changes with behaviour.
+    auto rng = std::make_unique<Random>(5489);
+    Zobrist::init_zobrist(*rng);
+
+    const auto corpus = play_games(games, vm["seed"].as<std::uint64_t>());
+    auto checksum = std::uint64_t{0};
+    const auto results = run_ops(corpus, repeat, checksum);
+
+#ifdef USE_COMPACT_BOARD
+    const auto board_name = "CompactBoard";
+#else
+    const auto board_name = "FullBoard";
+#endif
+    auto report = std::ostringstream{};
+    report << "{\"board\": \"" << board_name << "\""
+           << ", \"board_size\": " << BOARD_SIZE
+           << ", \"games\": " << games
+           << ", \"positions\": " << corpus.positions.size()
+           << ", \"repeat\": " << repeat
+           << ", \"checksum\": " << checksum
+           << ", \"ops\": [\n";
+    for (auto i = size_t{0}; i < results.size(); i++) {
+        const auto& result = results[i];
+        report << "    {\"name\": \"" << result.name << "\""
+               << ", \"calls\": " << result.calls
+               << ", \"ns_per_op\": " << json_number(result.ns_per_op) << "}"
+               << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    report << "]}\n";
+
+    if (vm.count("output")) {
+        auto file = std::ofstream{vm["output"].as<std::string>()};
+        if (!(file << report.str())) {
+            printf("ERROR: could not write %s\n",
+                   vm["output"].as<std::string>().c_str());
+            return EXIT_FAILURE;
+        }
+    } else {
+        std::cout << report.str();
+    }
+    return EXIT_SUCCESS;
+}
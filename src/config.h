@@ -112,6 +112,21 @@ static constexpr auto KOMI = 7.5f;
  */
 //#define USE_TUNER
 
+/*
+ * USE_PROFILER: Time the phases of each playout (selection, expansion,
+ * NN evaluation, backup...) and print a breakdown after every search.
+ * Also enables the lz-profile GTP command.
+ */
+//#define USE_PROFILER
+
+/*
+ * USE_COMPACT_BOARD: Keep positions in a CompactBoard, which stores the
+ * stones as bit planes plus a string root and liberty count per stone,
+ * instead of a FullBoard. Copying a position and scoring are several
+ * times cheaper, but playing a move is still about three times slower.
+ */
+//#define USE_COMPACT_BOARD
+
 static constexpr auto PROGRAM_NAME = "Leela Zero";
 static constexpr auto PROGRAM_VERSION = "0.17";
 
@@ -30,19 +30,29 @@
 
 #include "config.h"
 
+#include <array>
 #include <cstdint>
+#include <cstdio>
 #include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <regex>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "AnalysisEngine.h"
+#include "CompactBoard.h"
+#include "FullBoard.h"
 #include "GTP.h"
 #include "GameState.h"
+#include "Ladder.h"
 #include "NNCache.h"
 #include "Random.h"
+#include "RandomGame.h"
 #include "ThreadPool.h"
+#include "UCTSearch.h"
 #include "Utils.h"
 #include "Zobrist.h"
 
@@ -116,6 +126,34 @@ public:
     }
     void test_analyze_cmd(std::string cmd, bool valid, int who, int interval,
             int avoidlen, int avoidcolor, int avoiduntil);
+    static UCTNode& get_root(UCTSearch& search) {
+        return *search.m_root;
+    }
+    // Search in as many root-parallel groups as if there were that many
+    // NUMA nodes, without binding any threads.
+    static void use_search_groups(UCTSearch& search, size_t groups) {
+        search.m_numa_nodes.assign(groups, std::vector<int>{});
+    }
+    static UCTNode& get_summary_root(UCTSearch& search) {
+        return search.get_summary_root();
+    }
+    static size_t max_tree_size(const UCTSearch& search) {
+        return search.max_tree_size();
+    }
+    // Tree memory of the search once its pending deletions are done.
+    static size_t settled_tree_memory(UCTSearch& search) {
+        while (!search.m_delete_futures.empty()) {
+            search.m_delete_futures.front().wait_all();
+            search.m_delete_futures.pop_front();
+        }
+        return search.m_root->get_tree_memory();
+    }
+    // Read a ladder on the string at vertex with a budget of nodes.
+    static bool read_ladder(const GameBoard& board, int vertex, int attacker,
+                            int nodes) {
+        auto next = board;
+        return Ladder::capture(next, vertex, attacker, nodes);
+    }
 
 private:
     std::unique_ptr<GameState> m_gamestate;
@@ -384,3 +422,493 @@ TEST_F(LeelaTest, AnalyzeParseMinmoves) {
     // Expect to see at least 5 move priors
     expect_regex(result.first, "info.*?(prior\\s+\\d+\\s+.*?){5,}.*");
 }
+
+// Test analyzing several positions at once
+TEST_F(LeelaTest, AnalysisEngine) {
+    AnalysisEngine engine(*GTP::s_network, 2, 1);
+
+    auto results = std::vector<std::future<AnalysisResult>>{};
+    auto game = get_gamestate();
+    for (const auto move : {"q16", "d4", "q3"}) {
+        game.play_textmove(game.get_to_move() == FastBoard::BLACK ? "b" : "w",
+                           move);
+        results.emplace_back(engine.submit(game, 20));
+        results.emplace_back(engine.submit(game, 20, 0));
+    }
+    for (auto& future : results) {
+        auto result = future.get();
+        EXPECT_GE(result.visits, 20);
+        EXPECT_FALSE(result.moves.empty());
+    }
+}
+
+// Test that searches running side by side count only their own trees
+// and split the tree memory between them
+TEST_F(LeelaTest, ConcurrentSearchesCountOwnTrees) {
+    auto games = std::vector<GameState>(2, get_gamestate());
+    games[1].play_textmove("b", "q16");
+    auto searches = std::vector<std::unique_ptr<UCTSearch>>{};
+    for (auto& game : games) {
+        searches.emplace_back(
+            std::make_unique<UCTSearch>(game, *GTP::s_network));
+        searches.back()->set_thread_count(2);
+        searches.back()->set_concurrent_searches(2);
+        EXPECT_EQ(max_tree_size(*searches.back()), cfg_max_tree_size / 2);
+    }
+
+    // The second round reuses the trees and deletes the rest of the
+    // previous ones.
+    for (const auto move : {"d4", "q4"}) {
+        auto threads = std::vector<std::thread>{};
+        for (auto i = size_t{0}; i < searches.size(); i++) {
+            threads.emplace_back([&, i]() {
+                searches[i]->analyze(100);
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (auto i = size_t{0}; i < searches.size(); i++) {
+            const auto memory = settled_tree_memory(*searches[i]);
+            EXPECT_GT(memory, size_t{0});
+            EXPECT_EQ(searches[i]->get_tree_size(), memory);
+            games[i].play_textmove(
+                games[i].get_to_move() == FastBoard::BLACK ? "b" : "w", move);
+        }
+    }
+}
+
+// Test that a saved search tree loads back whole, and that a file
+// claiming more children than there are moves is refused
+TEST_F(LeelaTest, SaveAndLoadTree) {
+    const auto filename = std::string{"leelaz-test-tree.bin"};
+    auto game = get_gamestate();
+    game.play_textmove("b", "q16");
+    UCTSearch search(game, *GTP::s_network);
+    search.analyze(100);
+    ASSERT_TRUE(search.save_tree(filename));
+
+    UCTSearch loaded(game, *GTP::s_network);
+    ASSERT_TRUE(loaded.load_tree(filename));
+    EXPECT_EQ(get_root(loaded).get_visits(), get_root(search).get_visits());
+    EXPECT_EQ(get_root(loaded).get_tree_memory(),
+              get_root(search).get_tree_memory());
+
+    // The root's child count follows the 32 byte header and the 32
+    // bytes of the root's own statistics.
+    {
+        std::fstream file(filename,
+                          std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(64);
+        file.write("\xff\xff", 2);
+    }
+    UCTSearch corrupt(game, *GTP::s_network);
+    EXPECT_FALSE(corrupt.load_tree(filename));
+    std::remove(filename.c_str());
+}
+
+// Test that the summary of several search trees adds up their root
+// statistics move by move
+TEST_F(LeelaTest, SummarizeRoots) {
+    auto game = get_gamestate();
+    game.play_textmove("b", "q16");
+    auto searches = std::vector<std::unique_ptr<UCTSearch>>{};
+    auto roots = std::vector<const UCTNode*>{};
+    for (const auto visits : {50, 120}) {
+        searches.emplace_back(
+            std::make_unique<UCTSearch>(game, *GTP::s_network));
+        searches.back()->analyze(visits);
+        roots.emplace_back(&get_root(*searches.back()));
+    }
+
+    UCTNode summary(FastBoard::PASS, 0.0f);
+    summary.summarize_roots(roots);
+    EXPECT_TRUE(summary.has_children());
+    EXPECT_EQ(summary.get_visits(),
+              roots[0]->get_visits() + roots[1]->get_visits());
+    EXPECT_EQ(summary.get_children().size(), roots[0]->get_children().size());
+    for (const auto& child : summary.get_children()) {
+        auto visits = 0;
+        for (const auto root : roots) {
+            for (const auto& theirs : root->get_children()) {
+                if (theirs.get_move() == child.get_move()) {
+                    visits += theirs.get_visits();
+                }
+            }
+        }
+        EXPECT_EQ(child.get_visits(), visits);
+    }
+}
+
+// Test a search in several root-parallel groups, which time management
+// and output see through the summary of their roots
+TEST_F(LeelaTest, SearchGroups) {
+    auto game = get_gamestate();
+    UCTSearch search(game, *GTP::s_network);
+    use_search_groups(search, 2);
+    search.set_thread_count(4);
+    search.set_playout_limit(UCTSearch::UNLIMITED_PLAYOUTS);
+    search.set_visit_limit(400);
+    search.think(FastBoard::BLACK);
+    EXPECT_GE(get_summary_root(search).get_visits(), 400);
+    expect_regex(search.explain_last_think(), "PV: [A-T][0-9]+");
+
+    // The tree kept for reuse only counts its own visits.
+    const auto& root = get_root(search);
+    auto child_visits = 0;
+    for (const auto& child : root.get_children()) {
+        child_visits += child.get_visits();
+    }
+    EXPECT_EQ(root.get_visits(), child_visits + 1);
+    EXPECT_LT(root.get_visits(), get_summary_root(search).get_visits());
+}
+
+TEST_F(LeelaTest, LockstepIsDeterministic) {
+    cfg_lockstep = 4;
+
+    auto outputs = std::vector<std::string>{};
+    for (const auto threads : {1, 3}) {
+        auto game = get_gamestate();
+        UCTSearch search(game, *GTP::s_network);
+        search.set_thread_count(threads);
+        search.set_playout_limit(UCTSearch::UNLIMITED_PLAYOUTS);
+        search.set_visit_limit(200);
+        search.think(FastBoard::BLACK);
+        outputs.emplace_back(search.explain_last_think());
+    }
+    EXPECT_EQ(outputs[0], outputs[1]);
+}
+
+// Check the legal move mask against is_move_legal along random games.
+static void expect_legal_moves_match(const GameState& game) {
+    for (const auto color : {FastBoard::BLACK, FastBoard::WHITE}) {
+        const auto legal = game.get_legal_moves(color);
+        for (auto i = 0; i < NUM_INTERSECTIONS; i++) {
+            const auto vertex =
+                game.board.get_vertex(i % BOARD_SIZE, i / BOARD_SIZE);
+            ASSERT_EQ(legal[i], game.is_move_legal(color, vertex))
+                << "color " << color << " move "
+                << game.board.move_to_text(vertex)
+                << " movenum " << game.get_movenum();
+        }
+    }
+}
+
+TEST_F(LeelaTest, LegalMovesMatchIsMoveLegal) {
+    auto rng = Random{1234};
+    for (auto restricted = 0; restricted < 2; restricted++) {
+        auto game = get_gamestate();
+        if (restricted) {
+            cfg_analyze_tags.add_move_to_avoid(
+                FastBoard::BLACK, game.board.text_to_move("q16"), 20);
+            cfg_analyze_tags.add_move_to_allow(
+                FastBoard::WHITE, game.board.text_to_move("d4"), 2);
+            cfg_analyze_tags.add_move_to_allow(
+                FastBoard::WHITE, game.board.text_to_move("c3"), 5);
+            cfg_analyze_tags.compile_move_masks(game.board);
+        }
+        expect_legal_moves_match(game);
+        auto options = RandomGameOptions{};
+        options.max_moves = 400;
+        play_random_game(game, rng, options, [&](const GameState&, int, int) {
+            expect_legal_moves_match(game);
+            return !HasFailure();
+        });
+        cfg_analyze_tags = AnalyzeTags{};
+    }
+}
+
+// Play random games on a FullBoard and a CompactBoard side by side
+// and check that they agree on everything after every move.
+TEST_F(LeelaTest, CompactBoardMatchesFullBoard) {
+    auto rng = Random{4321};
+    auto options = RandomGameOptions{};
+    options.max_moves = 500;
+    for (auto game = 0; game < 4; game++) {
+        auto state = KoState{};
+        state.init_game(BOARD_SIZE, 7.5f);
+        auto full = FullBoard{};
+        auto compact = CompactBoard{};
+        full.reset_board(BOARD_SIZE);
+        compact.reset_board(BOARD_SIZE);
+
+        play_random_game(state, rng, options, [&](const KoState&,
+                                                  int color, int move) {
+            const auto komove = full.update_board(color, move);
+            EXPECT_EQ(komove, compact.update_board(color, move));
+            const auto to_move = state.get_to_move();
+            full.set_to_move(to_move);
+            compact.set_to_move(to_move);
+
+            EXPECT_EQ(full.get_hash(), compact.get_hash());
+            EXPECT_EQ(full.get_ko_hash(), compact.get_ko_hash());
+            EXPECT_EQ(full.calc_hash(komove), compact.calc_hash(komove));
+            for (auto s = 0; s < FullBoard::NUM_SYMMETRIES; s++) {
+                EXPECT_EQ(full.calc_symmetry_hash(komove, s),
+                          compact.calc_symmetry_hash(komove, s));
+                EXPECT_EQ(full.get_symmetry_hash(komove, s),
+                          compact.get_symmetry_hash(komove, s));
+            }
+            EXPECT_EQ(full.get_prisoners(FastBoard::BLACK),
+                      compact.get_prisoners(FastBoard::BLACK));
+            EXPECT_EQ(full.get_prisoners(FastBoard::WHITE),
+                      compact.get_prisoners(FastBoard::WHITE));
+            EXPECT_EQ(full.area_score(7.5f), compact.area_score(7.5f));
+            EXPECT_EQ(full.get_stone_list(), compact.get_stone_list());
+            EXPECT_EQ(full.get_empty_mask(), compact.get_empty_mask());
+            EXPECT_EQ(full.get_legal_mask(to_move),
+                      compact.get_legal_mask(to_move));
+
+            for (auto i = 0; i < NUM_INTERSECTIONS; i++) {
+                const auto vertex =
+                    full.get_vertex(i % BOARD_SIZE, i / BOARD_SIZE);
+                EXPECT_EQ(full.get_state(vertex), compact.get_state(vertex));
+                if (full.get_state(vertex) != FastBoard::EMPTY) {
+                    continue;
+                }
+                EXPECT_EQ(full.count_pliberties(vertex),
+                          compact.count_pliberties(vertex));
+                for (const auto c : {FastBoard::BLACK, FastBoard::WHITE}) {
+                    EXPECT_EQ(full.is_eye(c, vertex), compact.is_eye(c, vertex));
+                    EXPECT_EQ(full.is_suicide(vertex, c),
+                              compact.is_suicide(vertex, c));
+                }
+            }
+            return !HasFailure();
+        });
+    }
+}
+
+// Check superko detection against a plain list of the earlier positions
+// along random games, long enough to fill the shared hash set a few times.
+TEST_F(LeelaTest, SuperkoMatchesHistory) {
+    auto rng = Random{2718};
+    auto options = RandomGameOptions{};
+    options.max_moves = 600;
+    options.pass_odds = 8;
+    for (auto game = 0; game < 4; game++) {
+        auto state = KoState{};
+        state.init_game(BOARD_SIZE, 7.5f);
+        auto history = std::vector<std::uint64_t>{state.board.get_ko_hash()};
+        play_random_game(state, rng, options, [&](const KoState&, int, int) {
+            const auto repeated = std::find(begin(history), end(history),
+                state.board.get_ko_hash()) != end(history);
+            EXPECT_EQ(repeated, state.superko())
+                << "movenum " << history.size();
+            history.emplace_back(state.board.get_ko_hash());
+            // Folding the recent hashes early must not change anything.
+            if (history.size() % 7 == 0) {
+                state.fold_ko_hashes();
+            }
+
+            // Searches work on copies, which must not disturb the original.
+            auto copy = state;
+            copy.play_move(FastBoard::PASS);
+            EXPECT_TRUE(copy.superko());
+            return !HasFailure();
+        });
+    }
+}
+
+// Copies of a game share their history, so navigating one of them
+// must leave the others alone.
+TEST_F(LeelaTest, GameHistoryNavigation) {
+    auto game = get_gamestate();
+    auto hashes = std::vector<std::uint64_t>{game.board.get_hash()};
+    for (const auto move : {"d4", "q16", "c3", "pass", "e5"}) {
+        game.play_move(game.board.text_to_move(move));
+        hashes.emplace_back(game.board.get_hash());
+    }
+    for (auto h = 0; h < 5; h++) {
+        EXPECT_EQ(hashes[5 - h], game.get_past_board(h).get_hash());
+    }
+
+    auto copy = game;
+    EXPECT_TRUE(copy.undo_move());
+    EXPECT_TRUE(copy.undo_move());
+    EXPECT_EQ(hashes[3], copy.board.get_hash());
+    EXPECT_EQ(hashes[2], copy.get_past_board(1).get_hash());
+    EXPECT_EQ(hashes[5], game.board.get_hash());
+    EXPECT_EQ(6u, game.get_game_history().size());
+    EXPECT_EQ(4u, copy.get_game_history().size());
+
+    EXPECT_TRUE(copy.forward_move());
+    EXPECT_EQ(hashes[4], copy.board.get_hash());
+    EXPECT_EQ(4, copy.get_movenum());
+
+    // Playing after an undo cuts off the moves that were undone.
+    copy.play_move(copy.board.text_to_move("k10"));
+    EXPECT_FALSE(copy.forward_move());
+    EXPECT_EQ(hashes[4], copy.get_past_board(1).get_hash());
+
+    copy.rewind();
+    EXPECT_EQ(hashes[0], copy.board.get_hash());
+    EXPECT_EQ(0, copy.get_movenum());
+    EXPECT_FALSE(copy.undo_move());
+    EXPECT_EQ(hashes[5], game.board.get_hash());
+    EXPECT_TRUE(game.undo_move());
+    EXPECT_EQ(hashes[4], game.board.get_hash());
+}
+
+// Area score by a plain flood fill from every stone, one point at a time.
+static float flood_area_score(const FullBoard& board, float komi) {
+    auto reach = std::array<int, 2>{};
+    for (const auto color : {FastBoard::BLACK, FastBoard::WHITE}) {
+        auto seen = std::vector<bool>(FastBoard::NUM_VERTICES, false);
+        auto open = std::vector<int>{};
+        for (auto i = 0; i < board.get_boardsize(); i++) {
+            for (auto j = 0; j < board.get_boardsize(); j++) {
+                const auto vertex = board.get_vertex(i, j);
+                if (board.get_state(vertex) == color) {
+                    seen[vertex] = true;
+                    open.emplace_back(vertex);
+                }
+            }
+        }
+        while (!open.empty()) {
+            const auto vertex = open.back();
+            open.pop_back();
+            reach[color]++;
+            for (const auto dir : {1, -1, board.get_boardsize() + 2,
+                                   -(board.get_boardsize() + 2)}) {
+                const auto next = vertex + dir;
+                if (!seen[next] && board.get_state(next) == FastBoard::EMPTY) {
+                    seen[next] = true;
+                    open.emplace_back(next);
+                }
+            }
+        }
+    }
+    return reach[FastBoard::BLACK] - reach[FastBoard::WHITE] - komi;
+}
+
+TEST_F(LeelaTest, AreaScoreMatchesFloodFill) {
+    auto rng = Random{1618};
+    auto options = RandomGameOptions{};
+    options.max_moves = 300;
+    for (const auto boardsize : {BOARD_SIZE, 9, 7}) {
+        auto state = KoState{};
+        state.init_game(boardsize, 7.5f);
+        auto board = FullBoard{};
+        board.reset_board(boardsize);
+        play_random_game(state, rng, options, [&](const KoState&,
+                                                  int color, int move) {
+            board.update_board(color, move);
+            EXPECT_EQ(flood_area_score(board, 7.5f), board.area_score(7.5f))
+                << "boardsize " << boardsize;
+            return !HasFailure();
+        });
+    }
+}
+
+// The symmetry hashes kept up to date by FullBoard must match the ones
+// computed from scratch, captures and ko points included.
+TEST_F(LeelaTest, SymmetryHashesMatchCalculated) {
+    auto rng = Random{1414};
+    auto options = RandomGameOptions{};
+    options.max_moves = 400;
+    for (const auto boardsize : {BOARD_SIZE, 9}) {
+        auto state = KoState{};
+        state.init_game(boardsize, 7.5f);
+        auto board = FullBoard{};
+        board.reset_board(boardsize);
+        play_random_game(state, rng, options, [&](const KoState&,
+                                                  int color, int move) {
+            const auto komove = board.update_board(color, move);
+            board.set_to_move(state.get_to_move());
+            for (auto s = 0; s < FullBoard::NUM_SYMMETRIES; s++) {
+                EXPECT_EQ(board.calc_symmetry_hash(komove, s),
+                          board.get_symmetry_hash(komove, s))
+                    << "boardsize " << boardsize << " symmetry " << s;
+            }
+            EXPECT_EQ(board.calc_hash(komove),
+                      board.get_symmetry_hash(komove,
+                                              Network::IDENTITY_SYMMETRY));
+            return !HasFailure();
+        });
+    }
+}
+
+TEST_F(LeelaTest, LadderEscape) {
+    auto game = get_gamestate();
+    const auto play = [&](int color, const std::string& move) {
+        game.play_move(color, game.board.text_to_move(move));
+    };
+    // Black k10 in atari, chased towards the empty lower left corner.
+    play(FastBoard::BLACK, "k10");
+    play(FastBoard::WHITE, "j10");
+    play(FastBoard::WHITE, "k11");
+    play(FastBoard::WHITE, "l9");
+    play(FastBoard::WHITE, "l10");
+    game.set_to_move(FastBoard::BLACK);
+
+    const auto escape = game.board.text_to_move("k9");
+    EXPECT_TRUE(Ladder::is_ladder_escape(game, escape));
+    EXPECT_FALSE(Ladder::is_ladder_escape(game, game.board.text_to_move("q16")));
+    EXPECT_FALSE(Ladder::is_ladder_escape(game, FastBoard::PASS));
+    EXPECT_TRUE(Ladder::has_atari(game.board, FastBoard::BLACK));
+    EXPECT_FALSE(Ladder::has_atari(game.board, FastBoard::WHITE));
+
+    // The reading gives up once it runs out of nodes.
+    auto board = game.board;
+    board.update_board(FastBoard::BLACK, escape);
+    EXPECT_TRUE(LeelaTest::read_ladder(board, escape, FastBoard::WHITE,
+                                       Ladder::MAX_NODES));
+    EXPECT_FALSE(LeelaTest::read_ladder(board, escape, FastBoard::WHITE, 8));
+
+    // Black can capture the chasing k11 stone instead of running.
+    auto capturable = game;
+    capturable.play_move(FastBoard::BLACK, game.board.text_to_move("k12"));
+    capturable.play_move(FastBoard::BLACK, game.board.text_to_move("j11"));
+    capturable.set_to_move(FastBoard::BLACK);
+    EXPECT_TRUE(Ladder::has_atari(capturable.board, FastBoard::WHITE));
+    EXPECT_FALSE(Ladder::is_ladder_escape(capturable, escape));
+
+    // A black stone on the way breaks the ladder.
+    play(FastBoard::BLACK, "d4");
+    game.set_to_move(FastBoard::BLACK);
+    EXPECT_FALSE(Ladder::is_ladder_escape(game, escape));
+}
+
+// Check the strings and liberties FullBoard keeps up to date through
+// captures and merges against CompactBoard, which keeps them its own way
+// and flood fills the string masks.
+TEST_F(LeelaTest, StringsMatchFloodFill) {
+    auto rng = Random{1732};
+    auto options = RandomGameOptions{};
+    options.max_moves = 1000;
+    // Suicides included, they remove strings too.
+    options.anything_goes = true;
+    for (const auto boardsize : {BOARD_SIZE, 9, 5}) {
+        auto state = KoState{};
+        state.init_game(boardsize, 7.5f);
+        auto full = FullBoard{};
+        auto compact = CompactBoard{};
+        full.reset_board(boardsize);
+        compact.reset_board(boardsize);
+        play_random_game(state, rng, options, [&](const KoState&,
+                                                  int color, int move) {
+            full.update_board(color, move);
+            compact.update_board(color, move);
+
+            for (auto i = 0; i < boardsize; i++) {
+                for (auto j = 0; j < boardsize; j++) {
+                    const auto vertex = full.get_vertex(i, j);
+                    EXPECT_EQ(full.get_state(vertex), compact.get_state(vertex));
+                    if (full.get_state(vertex) == FastBoard::EMPTY) {
+                        continue;
+                    }
+                    EXPECT_EQ(compact.get_string_stones(vertex),
+                              full.get_string_stones(vertex));
+                    EXPECT_EQ(compact.get_string_liberties(vertex),
+                              full.get_string_liberties(vertex));
+                    EXPECT_EQ(compact.count_liberties(vertex),
+                              full.count_liberties(vertex))
+                        << "boardsize " << boardsize
+                        << " vertex " << full.move_to_text(vertex);
+                }
+            }
+            return !HasFailure();
+        });
+    }
+}